@@ -0,0 +1,429 @@
+/* Microbenchmarks for the individual stages of translation.
+ *
+ * Each benchmark is run a number of times and the fastest run reported, with
+ * every measurement divided by the number of code points processed. Where the
+ * kernel allows it, hardware counters are read through `perf_event_open`;
+ * otherwise, or for counters the CPU lacks, only wall-clock time is reported.
+ *
+ * Output is one tab-separated line per benchmark in a fixed order, with "-"
+ * for anything unavailable, so results from two builds can be compared with
+ * `paste` or `diff`.
+ */
+
+#define _GNU_SOURCE /* fopencookie */
+
+#include <assert.h>
+#include <getopt.h>
+#include "../src/internal.h"
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "utf8totex/utf8totex.h"
+
+/* Hardware counters. */
+
+enum { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, COUNTERS };
+
+static const char *const counter_names[COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses",
+};
+
+static int counter_fds[COUNTERS];
+
+static void counters_open(void) {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[COUNTERS] = {
+        [CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        [INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        [BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        [L1D_MISSES] = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+
+    for (size_t i = 0; i < COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counter_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+            0);
+    }
+}
+
+static void counters_start(void) {
+    for (size_t i = 0; i < COUNTERS; i++) {
+        if (counter_fds[i] >= 0) {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void counters_stop(double *values) {
+    for (size_t i = 0; i < COUNTERS; i++) {
+        uint64_t v;
+        if (counter_fds[i] >= 0) {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter_fds[i], &v, sizeof(v)) == sizeof(v)) {
+                values[i] = (double)v;
+                continue;
+            }
+        }
+        values[i] = -1;
+    }
+}
+
+/* Inputs. */
+
+/* A deterministic pseudo-random generator, so every build sees the same
+ * input.
+ */
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* A string built from `n` pieces chosen at random from `pieces`, or NULL on
+ * out-of-memory. `count` receives the number of code points in it.
+ */
+static char *build(const char *const *pieces, size_t n, size_t *count) {
+    size_t npieces = 0;
+    size_t longest = 0;
+    for (; pieces[npieces] != NULL; npieces++) {
+        size_t len = strlen(pieces[npieces]);
+        if (len > longest)
+            longest = len;
+    }
+
+    char *s = malloc(n * longest + 1);
+    if (s == NULL)
+        return NULL;
+
+    char *p = s;
+    *count = 0;
+    for (size_t i = 0; i < n; i++) {
+        const char *piece = pieces[rng() % npieces];
+        size_t len = strlen(piece);
+        memcpy(p, piece, len);
+        p += len;
+        for (size_t j = 0; j < len; j++) {
+            if (((unsigned char)piece[j] & 0xc0) != 0x80)
+                (*count)++;
+        }
+    }
+    *p = '\0';
+    return s;
+}
+
+/* Code points for `from_char`: ASCII, Latin, Greek and symbols, in proportions
+ * loosely resembling real text.
+ */
+#define CODE_POINTS (1 << 16)
+static uint32_t code_points[CODE_POINTS];
+
+static void build_code_points(void) {
+    for (size_t i = 0; i < CODE_POINTS; i++) {
+        uint32_t r = rng();
+        switch (r % 8) {
+            case 0 ... 3: code_points[i] = 0x20 + (r >> 8) % 0x5f;    break;
+            case 4 ... 5: code_points[i] = 0xa0 + (r >> 8) % 0x1b0;   break;
+            case 6:       code_points[i] = 0x391 + (r >> 8) % 0x38;   break;
+            default:      code_points[i] = 0x2000 + (r >> 8) % 0x300; break;
+        }
+    }
+}
+
+/* A stream that discards everything written to it, so benchmarks through
+ * `utf8totex_fputs_opt` measure translation rather than I/O.
+ */
+static ssize_t discard(void *cookie, const char *buf, size_t size) {
+    (void)cookie;
+    (void)buf;
+    return (ssize_t)size;
+}
+
+static FILE *sink;
+
+typedef __typeof__(UTF8TOTEX_DEFAULT_ENVIRONMENT.font_encoding) encoding_t;
+
+/* Benchmarks. Each processes its input once and returns the number of code
+ * points it processed.
+ */
+
+static char *decode_input;
+static size_t decode_count;
+
+static size_t bench_get_utf8_char(const void *arg) {
+    (void)arg;
+    uint32_t sum = 0;
+    const char *s = decode_input;
+    uint32_t c;
+    int len;
+    while ((len = get_utf8_char(&c, s)) > 0) {
+        sum += c;
+        s += len;
+    }
+    /* Keep the loop from being optimised away. */
+    __asm__ volatile ("" : : "r"(sum));
+    return decode_count;
+}
+
+static size_t bench_from_char(const void *arg) {
+    utf8totex_environment_t env = UTF8TOTEX_DEFAULT_ENVIRONMENT;
+    env.font_encoding = *(const encoding_t*)arg;
+    env.textcomp = true;
+    size_t sum = 0;
+    for (size_t i = 0; i < CODE_POINTS; i++) {
+        const char *s = NULL;
+        sum += (size_t)utf8totex_from_char(&s, code_points[i], env);
+        sum += (size_t)s;
+    }
+    __asm__ volatile ("" : : "r"(sum));
+    return CODE_POINTS;
+}
+
+typedef struct {
+    const char *const *pieces;
+    utf8totex_options_t options;
+    char *input;
+    size_t count;
+} fputs_bench_t;
+
+static size_t bench_fputs(const void *arg) {
+    const fputs_bench_t *b = arg;
+    int r = utf8totex_fputs_opt(b->input, b->options, sink, NULL);
+    assert(r == 0);
+    (void)r;
+    return b->count;
+}
+
+/* Plain text with the occasional escape, to exercise the lookahead. */
+static const char *const lookahead_pieces[] = { "a", "b", "e", "n", "t", " ",
+    ".", "\xc3\xa9", "\xc3\x9f", "\xce\xb1", "\xce\xb2", "\xe2\x80\x94",
+    "\xc2\xb1", NULL };
+
+/* Letters followed by combining accents. */
+static const char *const modifier_pieces[] = { "a", "e", "i", "j", "o", " ",
+    "a\xcc\x81", "e\xcc\x80", "i\xcc\x88", "j\xcc\x8c", "o\xcc\x83",
+    "c\xcc\xa7", NULL };
+
+/* Input that keeps the fuzzy state machine in each of its states. */
+static const char *const fuzzy_idle_pieces[] = { "a", "e", " ", "\xc3\xa9",
+    "\xce\xb1", NULL };
+static const char *const fuzzy_macro_pieces[] = { "\\emph ", "\\LaTeX ",
+    "\\alpha ", NULL };
+static const char *const fuzzy_braced_pieces[] = { "{abc}", "{x{y}z}",
+    "{\\bf text}", NULL };
+static const char *const fuzzy_math_pieces[] = { "$x+y$", "$\\frac{a}{b}$",
+    "$e^{i\\pi}$", NULL };
+
+typedef struct {
+    char name[32];
+    size_t (*run)(const void *arg);
+    const void *arg;
+} benchmark_t;
+
+static void report(const benchmark_t *b, unsigned reps, bool have_counters) {
+    double best[COUNTERS];
+    double best_ns = -1;
+    size_t count = 0;
+
+    for (unsigned rep = 0; rep < reps; rep++) {
+        double values[COUNTERS];
+        struct timespec start, stop;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (have_counters)
+            counters_start();
+        count = b->run(b->arg);
+        if (have_counters) {
+            counters_stop(values);
+        } else {
+            for (size_t i = 0; i < COUNTERS; i++)
+                values[i] = -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        double ns = (double)(stop.tv_sec - start.tv_sec) * 1e9 +
+                    (double)(stop.tv_nsec - start.tv_nsec);
+        if (best_ns < 0 || ns < best_ns)
+            best_ns = ns;
+        for (size_t i = 0; i < COUNTERS; i++) {
+            if (rep == 0 || (values[i] >= 0 && values[i] < best[i]))
+                best[i] = values[i];
+        }
+    }
+
+    printf("%s", b->name);
+    for (size_t i = 0; i < COUNTERS; i++) {
+        if (best[i] < 0) {
+            printf("\t-");
+        } else {
+            printf("\t%.3f", best[i] / (double)count);
+        }
+    }
+    printf("\t%.3f\n", best_ns / (double)count);
+}
+
+int main(int argc, char **argv) {
+    unsigned reps = 5;
+    const char *filter = NULL;
+
+    int c;
+    while ((c = getopt(argc, argv, "r:f:")) != -1) {
+        switch (c) {
+            case 'r':
+                reps = (unsigned)strtoul(optarg, NULL, 10);
+                if (reps == 0)
+                    reps = 1;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r repetitions] [-f filter]\n"
+                                " -r N    Run each benchmark N times and report "
+                                "the fastest (default 5)\n"
+                                " -f STR  Only run benchmarks whose name "
+                                "contains STR\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    sink = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = discard });
+    if (sink == NULL) {
+        perror("fopencookie");
+        return EXIT_FAILURE;
+    }
+
+    static const char *const decode_pieces[] = { "a", "z", " ", "\xc3\xa9",
+        "\xce\xb1", "\xe2\x80\x94", "\xf0\x9d\x90\x80", NULL };
+    decode_input = build(decode_pieces, 1 << 20, &decode_count);
+
+    build_code_points();
+
+    static const struct {
+        const char *name;
+        const char *const *pieces;
+        bool fuzzy;
+        utf8totex_elide_t elide;
+        bool coalesce_math;
+        size_t line_limit;
+    } fputs_specs[] = {
+        { "fputs/lookahead",       lookahead_pieces,    false,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+        { "fputs/lookahead-elide", lookahead_pieces,    false,
+          UTF8TOTEX_ELIDE_ALL, true, 0 },
+        { "fputs/line-limit",      lookahead_pieces,    false,
+          UTF8TOTEX_ELIDE_NONE, false, 80 },
+        { "fputs/modifier",        modifier_pieces,     false,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+        { "fputs/modifier-elide",  modifier_pieces,     false,
+          UTF8TOTEX_ELIDE_ALL, false, 0 },
+        { "fuzzy/idle",            fuzzy_idle_pieces,   true,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+        { "fuzzy/macro",           fuzzy_macro_pieces,  true,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+        { "fuzzy/braced",          fuzzy_braced_pieces, true,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+        { "fuzzy/math",            fuzzy_math_pieces,   true,
+          UTF8TOTEX_ELIDE_NONE, false, 0 },
+    };
+    enum { FPUTS_BENCHMARKS = sizeof(fputs_specs) / sizeof(fputs_specs[0]) };
+    fputs_bench_t fputs_benches[FPUTS_BENCHMARKS];
+
+    static const struct {
+        const char *name;
+        encoding_t encoding;
+    } encodings[] = {
+        { "ot1", UTF8TOTEX_FE_OT1 }, { "ot2", UTF8TOTEX_FE_OT2 },
+        { "ot3", UTF8TOTEX_FE_OT3 }, { "ot4", UTF8TOTEX_FE_OT4 },
+        { "ot6", UTF8TOTEX_FE_OT6 }, { "t1", UTF8TOTEX_FE_T1 },
+        { "t2a", UTF8TOTEX_FE_T2A }, { "t2b", UTF8TOTEX_FE_T2B },
+        { "t2c", UTF8TOTEX_FE_T2C }, { "t3", UTF8TOTEX_FE_T3 },
+        { "t4", UTF8TOTEX_FE_T4 }, { "t5", UTF8TOTEX_FE_T5 },
+        { "ts1", UTF8TOTEX_FE_TS1 }, { "ts3", UTF8TOTEX_FE_TS3 },
+        { "x2", UTF8TOTEX_FE_X2 }, { "oml", UTF8TOTEX_FE_OML },
+        { "oms", UTF8TOTEX_FE_OMS }, { "omx", UTF8TOTEX_FE_OMX },
+    };
+    enum { ENCODINGS = sizeof(encodings) / sizeof(encodings[0]) };
+
+    benchmark_t benchmarks[1 + ENCODINGS + FPUTS_BENCHMARKS];
+    size_t n = 0;
+
+    benchmarks[n++] = (benchmark_t){ "get_utf8_char", bench_get_utf8_char,
+        NULL };
+    for (size_t i = 0; i < ENCODINGS; i++) {
+        benchmarks[n] = (benchmark_t){ .run = bench_from_char,
+            .arg = &encodings[i].encoding };
+        snprintf(benchmarks[n].name, sizeof(benchmarks[n].name),
+            "from_char/%s", encodings[i].name);
+        n++;
+    }
+    for (size_t i = 0; i < FPUTS_BENCHMARKS; i++) {
+        fputs_bench_t *b = &fputs_benches[i];
+        b->options = UTF8TOTEX_DEFAULT_OPTIONS;
+        b->options.fuzzy = fputs_specs[i].fuzzy;
+        b->options.elide_braces = fputs_specs[i].elide;
+        b->options.coalesce_math = fputs_specs[i].coalesce_math;
+        b->options.line_limit = fputs_specs[i].line_limit;
+        b->input = build(fputs_specs[i].pieces, 1 << 18, &b->count);
+        if (b->input == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        benchmarks[n] = (benchmark_t){ .run = bench_fputs, .arg = b };
+        snprintf(benchmarks[n].name, sizeof(benchmarks[n].name), "%s",
+            fputs_specs[i].name);
+        n++;
+    }
+
+    if (decode_input == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    counters_open();
+    bool have_counters = false;
+    for (size_t i = 0; i < COUNTERS; i++)
+        have_counters |= counter_fds[i] >= 0;
+
+    printf("# utf8totex %s, %s, per code point, best of %u\n",
+        utf8totex_version(),
+        have_counters ? "perf_event_open" : "wall-clock only", reps);
+    printf("benchmark");
+    for (size_t i = 0; i < COUNTERS; i++)
+        printf("\t%s", counter_names[i]);
+    printf("\tns\n");
+
+    for (size_t i = 0; i < n; i++) {
+        if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL)
+            continue;
+        report(&benchmarks[i], reps, have_counters);
+    }
+
+    for (size_t i = 0; i < FPUTS_BENCHMARKS; i++)
+        free(fputs_benches[i].input);
+    free(decode_input);
+    fclose(sink);
+    return EXIT_SUCCESS;
+}
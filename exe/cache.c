@@ -0,0 +1,165 @@
+#define _GNU_SOURCE /* copy_file_range */
+
+#include <assert.h>
+#include "cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Entries are spread over subdirectories named after the first two characters
+ * of their key to keep directory sizes manageable.
+ */
+static char *entry_path(const char *dir, const char *key, int mkdirs) {
+    assert(strlen(key) > 2);
+
+    size_t size = strlen(dir) + strlen(key) + sizeof("//");
+    char *path = malloc(size);
+    if (path == NULL)
+        return NULL;
+
+    snprintf(path, size, "%s/%.2s", dir, key);
+    if (mkdirs) {
+        if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+            free(path);
+            return NULL;
+        }
+        if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+            free(path);
+            return NULL;
+        }
+    }
+    snprintf(path, size, "%s/%.2s/%s", dir, key, key + 2);
+    return path;
+}
+
+int cache_open(const char *dir, const char *key) {
+    assert(dir != NULL);
+    assert(key != NULL);
+
+    char *path = entry_path(dir, key, 0);
+    if (path == NULL)
+        return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    return fd;
+}
+
+int cache_send(int fd, FILE *out) {
+    assert(out != NULL);
+
+    if (fflush(out) != 0)
+        return -1;
+    int out_fd = fileno(out);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return -1;
+    off_t offset = 0;
+
+    /* Let the kernel do the copying if it can. `copy_file_range` allows
+     * reflinks or server-side copies when writing to a regular file, while
+     * `sendfile` handles pipes and sockets.
+     */
+    while (offset < st.st_size) {
+        ssize_t n = copy_file_range(fd, &offset, out_fd, NULL,
+            (size_t)(st.st_size - offset), 0);
+        if (n <= 0)
+            break;
+    }
+    while (offset < st.st_size) {
+        ssize_t n = sendfile(out_fd, fd, &offset,
+            (size_t)(st.st_size - offset));
+        if (n <= 0)
+            break;
+    }
+
+    /* Fall back to doing it ourselves. */
+    if (offset < st.st_size) {
+        if (lseek(fd, offset, SEEK_SET) == (off_t)-1)
+            return -1;
+        char buffer[BUFSIZ];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            if (fwrite(buffer, 1, (size_t)n, out) != (size_t)n)
+                return -1;
+        }
+        if (n < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int cache_create(cache_entry_t *entry, const char *dir) {
+    assert(entry != NULL);
+    assert(dir != NULL);
+
+    memset(entry, 0, sizeof(*entry));
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+        return -1;
+
+    entry->dir = strdup(dir);
+    size_t size = strlen(dir) + sizeof("/.tmp.XXXXXX");
+    entry->tmp_path = malloc(size);
+    if (entry->dir == NULL || entry->tmp_path == NULL)
+        goto fail;
+    snprintf(entry->tmp_path, size, "%s/.tmp.XXXXXX", dir);
+
+    int fd = mkstemp(entry->tmp_path);
+    if (fd == -1)
+        goto fail;
+    entry->f = fdopen(fd, "w+");
+    if (entry->f == NULL) {
+        close(fd);
+        unlink(entry->tmp_path);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    free(entry->tmp_path);
+    free(entry->dir);
+    memset(entry, 0, sizeof(*entry));
+    return -1;
+}
+
+int cache_commit(cache_entry_t *entry, const char *key) {
+    assert(entry != NULL);
+    assert(key != NULL);
+
+    int r = -1;
+    if (fclose(entry->f) == 0) {
+        entry->f = NULL;
+        char *path = entry_path(entry->dir, key, 1);
+        if (path != NULL) {
+            /* Mode from `mkstemp` is 0600; make entries shareable. */
+            (void)chmod(entry->tmp_path, 0644);
+            r = rename(entry->tmp_path, path);
+            free(path);
+        }
+    }
+
+    entry->f = NULL;
+    if (r != 0)
+        unlink(entry->tmp_path);
+    free(entry->tmp_path);
+    free(entry->dir);
+    return r;
+}
+
+void cache_abandon(cache_entry_t *entry) {
+    assert(entry != NULL);
+
+    if (entry->f != NULL)
+        fclose(entry->f);
+    unlink(entry->tmp_path);
+    free(entry->tmp_path);
+    free(entry->dir);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+
+/* Content-addressed store of translated output, keyed by a hash of the input
+ * and everything else affecting its translation. Entries are written to a
+ * temporary file and renamed into place, so concurrent users of the same cache
+ * directory only ever see complete entries.
+ */
+
+typedef struct {
+    FILE *f;         /* Stream to write the new entry to */
+    char *tmp_path;  /* Where it is being written */
+    char *dir;       /* Cache directory it belongs in */
+} cache_entry_t;
+
+/* Open the entry for `key`, returning a file descriptor or -1 if it does not
+ * exist.
+ */
+int cache_open(const char *dir, const char *key);
+
+/* Copy the entire contents of `fd`, from its start, to `out`. */
+int cache_send(int fd, FILE *out);
+
+/* Start writing a new cache entry. */
+int cache_create(cache_entry_t *entry, const char *dir);
+
+/* Publish a fully written entry under `key` and release it. */
+int cache_commit(cache_entry_t *entry, const char *key);
+
+/* Discard an entry without publishing it. */
+void cache_abandon(cache_entry_t *entry);
@@ -0,0 +1,960 @@
+#define _GNU_SOURCE /* fopencookie */
+
+#include <assert.h>
+#include "codec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "uring.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* Size of the buffers of uncompressed data passed between threads and how many
+ * of them there are for each stream. This bounds how far the codec thread can
+ * get ahead of, or fall behind, translation.
+ */
+#define BUFFER_SIZE (1024 * 1024)
+#define QUEUE_DEPTH 4
+
+/* Size of the buffers for compressed data, used only on the codec thread. */
+#define CODEC_BUFFER_SIZE (256 * 1024)
+
+/* A queue of buffers between a single producer and a single consumer. The
+ * buffers are allocated up front and cycle between the two: the producer fills
+ * the slot at `head` and the consumer drains the slot at `tail`.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct {
+        char *data;
+        size_t len;
+    } slots[QUEUE_DEPTH];
+    size_t head;  /* Slots filled so far */
+    size_t tail;  /* Slots drained so far */
+    bool done;    /* The producer has finished */
+    bool failed;  /* Either side has given up */
+} queue_t;
+
+static void queue_destroy(queue_t *q) {
+    for (size_t i = 0; i < QUEUE_DEPTH; i++)
+        free(q->slots[i].data);
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+}
+
+static int queue_init(queue_t *q) {
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    for (size_t i = 0; i < QUEUE_DEPTH; i++) {
+        q->slots[i].data = malloc(BUFFER_SIZE);
+        if (q->slots[i].data == NULL) {
+            queue_destroy(q);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Get the next slot for the producer to fill, waiting for one to be free, or
+ * `NULL` if the consumer has given up.
+ */
+static char *queue_acquire(queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    while (!q->failed && q->head - q->tail == QUEUE_DEPTH)
+        pthread_cond_wait(&q->cond, &q->lock);
+    char *p = q->failed ? NULL : q->slots[q->head % QUEUE_DEPTH].data;
+    pthread_mutex_unlock(&q->lock);
+    return p;
+}
+
+/* Pass the acquired slot, now holding `len` bytes, to the consumer. */
+static void queue_push(queue_t *q, size_t len) {
+    pthread_mutex_lock(&q->lock);
+    q->slots[q->head % QUEUE_DEPTH].len = len;
+    q->head++;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Indicate the producer will push no more slots. */
+static void queue_finish(queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->done = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Give up, from either side. */
+static void queue_fail(queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->failed = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Get the next slot for the consumer to drain, waiting for one to be filled.
+ * Returns `1` on success, `0` if the producer has finished or `-1` if it gave
+ * up.
+ */
+static int queue_pop(queue_t *q, char **data, size_t *len) {
+    pthread_mutex_lock(&q->lock);
+    while (!q->failed && !q->done && q->tail == q->head)
+        pthread_cond_wait(&q->cond, &q->lock);
+    int r = q->failed ? -1 : q->tail == q->head ? 0 : 1;
+    if (r == 1) {
+        *data = q->slots[q->tail % QUEUE_DEPTH].data;
+        *len = q->slots[q->tail % QUEUE_DEPTH].len;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return r;
+}
+
+/* Return the popped slot to the producer. */
+static void queue_release(queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->tail++;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+typedef struct {
+    codec_t codec;
+    FILE *f;  /* Underlying compressed stream */
+    queue_t queue;
+    pthread_t thread;
+    bool ok;  /* Result of the codec thread, once joined */
+
+    /* Bytes consumed from `f` while sniffing for a header. */
+    unsigned char prefix[4];
+    size_t prefix_len;
+
+    /* The slot the main thread is draining or filling, how much data it holds
+     * and, when reading, how much of that has been consumed.
+     */
+    char *slot;
+    size_t len;
+    size_t offset;
+} stream_t;
+
+codec_t codec_from_name(const char *path) {
+    assert(path != NULL);
+
+    size_t len = strlen(path);
+    if (len > 3 && strcmp(path + len - 3, ".gz") == 0)
+        return CODEC_GZIP;
+    if (len > 4 && strcmp(path + len - 4, ".zst") == 0)
+        return CODEC_ZSTD;
+    return CODEC_NONE;
+}
+
+bool codec_available(codec_t codec) {
+    switch (codec) {
+        case CODEC_NONE: return true;
+#ifdef HAVE_ZLIB
+        case CODEC_GZIP: return true;
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD: return true;
+#endif
+        default:         return false;
+    }
+}
+
+/* Decompression. These run on the codec thread, filling slots with
+ * decompressed data and returning whether the whole input was decompressed.
+ */
+
+/* Read compressed input, starting with anything consumed by sniffing. */
+static size_t read_input(stream_t *s, void *buffer, size_t size) {
+    assert(size >= sizeof(s->prefix));
+
+    size_t n = s->prefix_len;
+    memcpy(buffer, s->prefix, n);
+    s->prefix_len = 0;
+    return n + fread((char*)buffer + n, 1, size - n, s->f);
+}
+
+static bool copy_through(stream_t *s) {
+    for (;;) {
+        char *out = queue_acquire(&s->queue);
+        if (out == NULL)
+            return false;
+        size_t n = read_input(s, out, BUFFER_SIZE);
+        if (n == 0)
+            return !ferror(s->f);
+        queue_push(&s->queue, n);
+    }
+}
+
+#ifdef HAVE_ZLIB
+static bool gzip_in(stream_t *s) {
+    unsigned char *in = malloc(CODEC_BUFFER_SIZE);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    /* 16 selects a gzip wrapper. */
+    if (in == NULL || inflateInit2(&z, 15 + 16) != Z_OK) {
+        free(in);
+        return false;
+    }
+
+    bool ok = false;
+    bool member_end = false;
+    char *out = queue_acquire(&s->queue);
+    size_t out_len = 0;
+    while (out != NULL) {
+        if (z.avail_in == 0) {
+            z.next_in = in;
+            z.avail_in = (uInt)read_input(s, in, CODEC_BUFFER_SIZE);
+            if (z.avail_in == 0) {
+                ok = member_end && !ferror(s->f);
+                break;
+            }
+        }
+
+        /* A gzip file may consist of several concatenated members. */
+        if (member_end) {
+            if (inflateReset(&z) != Z_OK)
+                break;
+            member_end = false;
+        }
+
+        z.next_out = (unsigned char*)out + out_len;
+        z.avail_out = (uInt)(BUFFER_SIZE - out_len);
+        int r = inflate(&z, Z_NO_FLUSH);
+        out_len = BUFFER_SIZE - z.avail_out;
+        if (r == Z_STREAM_END) {
+            member_end = true;
+        } else if (r != Z_OK) {
+            break;
+        }
+
+        if (out_len == BUFFER_SIZE) {
+            queue_push(&s->queue, out_len);
+            out = queue_acquire(&s->queue);
+            out_len = 0;
+        }
+    }
+    if (ok && out_len > 0)
+        queue_push(&s->queue, out_len);
+
+    inflateEnd(&z);
+    free(in);
+    return ok;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static bool zstd_in(stream_t *s) {
+    size_t in_size = ZSTD_DStreamInSize();
+    unsigned char *in = malloc(in_size);
+    ZSTD_DCtx *d = ZSTD_createDCtx();
+    if (in == NULL || d == NULL) {
+        ZSTD_freeDCtx(d);
+        free(in);
+        return false;
+    }
+
+    bool ok = false;
+    ZSTD_inBuffer ib = { in, 0, 0 };
+    /* Non-zero while a frame is incomplete. Frames can be concatenated. */
+    size_t pending = 1;
+    char *out = queue_acquire(&s->queue);
+    size_t out_len = 0;
+    while (out != NULL) {
+        if (ib.pos == ib.size) {
+            ib.size = read_input(s, in, in_size);
+            ib.pos = 0;
+            if (ib.size == 0) {
+                ok = pending == 0 && !ferror(s->f);
+                break;
+            }
+        }
+
+        ZSTD_outBuffer ob = { out, BUFFER_SIZE, out_len };
+        pending = ZSTD_decompressStream(d, &ob, &ib);
+        if (ZSTD_isError(pending))
+            break;
+        out_len = ob.pos;
+
+        if (out_len == BUFFER_SIZE) {
+            queue_push(&s->queue, out_len);
+            out = queue_acquire(&s->queue);
+            out_len = 0;
+        }
+    }
+    if (ok && out_len > 0)
+        queue_push(&s->queue, out_len);
+
+    ZSTD_freeDCtx(d);
+    free(in);
+    return ok;
+}
+#endif
+
+static void *run_decompressor(void *arg) {
+    stream_t *s = arg;
+
+    bool ok;
+    switch (s->codec) {
+#ifdef HAVE_ZLIB
+        case CODEC_GZIP: ok = gzip_in(s);      break;
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD: ok = zstd_in(s);      break;
+#endif
+        default:         ok = copy_through(s); break;
+    }
+
+    if (ok) {
+        queue_finish(&s->queue);
+    } else {
+        queue_fail(&s->queue);
+    }
+    return NULL;
+}
+
+/* Compression. These run on the codec thread, draining slots and writing the
+ * compressed result, and return whether everything was written.
+ */
+
+static bool copy_out(stream_t *s) {
+    for (;;) {
+        char *data = NULL;
+        size_t len = 0;
+        int more = queue_pop(&s->queue, &data, &len);
+        if (more <= 0)
+            return more == 0;
+        if (fwrite(data, 1, len, s->f) != len)
+            return false;
+        queue_release(&s->queue);
+    }
+}
+
+#ifdef HAVE_ZLIB
+static bool gzip_out(stream_t *s) {
+    unsigned char *out = malloc(CODEC_BUFFER_SIZE);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (out == NULL || deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                    15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(out);
+        return false;
+    }
+
+    bool ok = true;
+    for (;;) {
+        char *data = NULL;
+        size_t len = 0;
+        int more = queue_pop(&s->queue, &data, &len);
+        if (more < 0) {
+            ok = false;
+            break;
+        }
+
+        z.next_in = (unsigned char*)data;
+        z.avail_in = (uInt)len;
+        int flush = more ? Z_NO_FLUSH : Z_FINISH;
+        do {
+            z.next_out = out;
+            z.avail_out = CODEC_BUFFER_SIZE;
+            if (deflate(&z, flush) == Z_STREAM_ERROR) {
+                ok = false;
+                break;
+            }
+            size_t n = CODEC_BUFFER_SIZE - z.avail_out;
+            if (n > 0 && fwrite(out, 1, n, s->f) != n) {
+                ok = false;
+                break;
+            }
+        } while (z.avail_out == 0);
+
+        if (!ok || !more)
+            break;
+        queue_release(&s->queue);
+    }
+
+    deflateEnd(&z);
+    free(out);
+    return ok;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static bool zstd_out(stream_t *s) {
+    size_t out_size = ZSTD_CStreamOutSize();
+    unsigned char *out = malloc(out_size);
+    ZSTD_CCtx *c = ZSTD_createCCtx();
+    if (out == NULL || c == NULL) {
+        ZSTD_freeCCtx(c);
+        free(out);
+        return false;
+    }
+
+    bool ok = true;
+    for (;;) {
+        char *data = NULL;
+        size_t len = 0;
+        int more = queue_pop(&s->queue, &data, &len);
+        if (more < 0) {
+            ok = false;
+            break;
+        }
+
+        ZSTD_inBuffer ib = { data, len, 0 };
+        ZSTD_EndDirective mode = more ? ZSTD_e_continue : ZSTD_e_end;
+        bool finished;
+        do {
+            ZSTD_outBuffer ob = { out, out_size, 0 };
+            size_t remaining = ZSTD_compressStream2(c, &ob, &ib, mode);
+            if (ZSTD_isError(remaining) ||
+                (ob.pos > 0 && fwrite(out, 1, ob.pos, s->f) != ob.pos)) {
+                ok = false;
+                break;
+            }
+            finished = more ? ib.pos == ib.size : remaining == 0;
+        } while (!finished);
+
+        if (!ok || !more)
+            break;
+        queue_release(&s->queue);
+    }
+
+    ZSTD_freeCCtx(c);
+    free(out);
+    return ok;
+}
+#endif
+
+static void *run_compressor(void *arg) {
+    stream_t *s = arg;
+
+    switch (s->codec) {
+#ifdef HAVE_ZLIB
+        case CODEC_GZIP: s->ok = gzip_out(s);   break;
+#endif
+#ifdef HAVE_ZSTD
+        case CODEC_ZSTD: s->ok = zstd_out(s);   break;
+#endif
+        default:         s->ok = copy_out(s); break;
+    }
+
+    /* Stop the main thread from filling any more slots. */
+    if (!s->ok)
+        queue_fail(&s->queue);
+    return NULL;
+}
+
+/* The main thread's side of the streams. */
+
+static ssize_t reader_read(void *cookie, char *buf, size_t size) {
+    stream_t *s = cookie;
+
+    while (s->slot == NULL || s->offset == s->len) {
+        if (s->slot != NULL) {
+            queue_release(&s->queue);
+            s->slot = NULL;
+        }
+        int r = queue_pop(&s->queue, &s->slot, &s->len);
+        if (r <= 0) {
+            s->slot = NULL;
+            if (r < 0) {
+                errno = EIO;
+                return -1;
+            }
+            return 0;
+        }
+        s->offset = 0;
+    }
+
+    size_t n = s->len - s->offset;
+    if (n > size)
+        n = size;
+    memcpy(buf, s->slot + s->offset, n);
+    s->offset += n;
+    return (ssize_t)n;
+}
+
+static int reader_close(void *cookie) {
+    stream_t *s = cookie;
+
+    /* Stop the codec thread if we did not read everything. */
+    queue_fail(&s->queue);
+    pthread_join(s->thread, NULL);
+
+    int r = fclose(s->f);
+    queue_destroy(&s->queue);
+    free(s);
+    return r;
+}
+
+static ssize_t writer_write(void *cookie, const char *buf, size_t size) {
+    stream_t *s = cookie;
+
+    size_t written = 0;
+    while (written < size) {
+        if (s->slot == NULL) {
+            s->slot = queue_acquire(&s->queue);
+            if (s->slot == NULL) {
+                errno = EIO;
+                return (ssize_t)written;
+            }
+            s->len = 0;
+        }
+
+        size_t n = BUFFER_SIZE - s->len;
+        if (n > size - written)
+            n = size - written;
+        memcpy(s->slot + s->len, buf + written, n);
+        s->len += n;
+        written += n;
+
+        if (s->len == BUFFER_SIZE) {
+            queue_push(&s->queue, s->len);
+            s->slot = NULL;
+        }
+    }
+    return (ssize_t)size;
+}
+
+static int writer_close(void *cookie) {
+    stream_t *s = cookie;
+
+    if (s->slot != NULL && s->len > 0)
+        queue_push(&s->queue, s->len);
+    queue_finish(&s->queue);
+    pthread_join(s->thread, NULL);
+
+    int r = s->ok ? 0 : EOF;
+    if (fclose(s->f) != 0)
+        r = EOF;
+    queue_destroy(&s->queue);
+    free(s);
+    return r;
+}
+
+/* Uncompressed input and output of regular files through io_uring. Here the
+ * main thread needs no helper: every slot but the one it is using has a read
+ * or write in flight, at its own offset in the file. Completions are only
+ * waited for when the main thread needs the next slot.
+ */
+
+typedef struct {
+    uring_t *ring;
+    FILE *f;
+    int fd;
+    off_t offset;  /* Where in the file the next request starts */
+    bool failed;
+
+    struct {
+        char *data;
+        off_t offset;  /* Where in the file this slot's data belongs */
+        size_t len;    /* Size of the write in flight */
+        size_t done;   /* Bytes read or written so far */
+        bool busy;     /* Whether a request is in flight */
+    } slots[QUEUE_DEPTH];
+
+    /* The slot the main thread is draining or filling and, when reading, how
+     * much of it has been consumed.
+     */
+    size_t current;
+    size_t pos;
+} aio_t;
+
+static void aio_free(aio_t *a) {
+    uring_free(a->ring);
+    for (size_t i = 0; i < QUEUE_DEPTH; i++)
+        free(a->slots[i].data);
+    free(a);
+}
+
+/* Open a regular file for io_uring, or return `NULL` if this is not possible.
+ * `offset` is the position in the file to start from.
+ */
+static aio_t *aio_new(FILE *f, off_t offset) {
+    int fd = fileno(f);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || offset < 0)
+        return NULL;
+
+    aio_t *a = calloc(1, sizeof(*a));
+    if (a == NULL)
+        return NULL;
+    a->f = f;
+    a->fd = fd;
+    a->offset = offset;
+    for (size_t i = 0; i < QUEUE_DEPTH; i++) {
+        a->slots[i].data = malloc(BUFFER_SIZE);
+        if (a->slots[i].data == NULL) {
+            aio_free(a);
+            return NULL;
+        }
+    }
+    a->ring = uring_new(QUEUE_DEPTH);
+    if (a->ring == NULL) {
+        aio_free(a);
+        return NULL;
+    }
+    return a;
+}
+
+/* Issue, or reissue after a short transfer, the request for slot `i`. */
+static int aio_submit(aio_t *a, size_t i, bool write) {
+    char *p = a->slots[i].data + a->slots[i].done;
+    off_t offset = a->slots[i].offset + (off_t)a->slots[i].done;
+    a->slots[i].busy = true;
+    int r = write
+        ? uring_write(a->ring, a->fd, p, a->slots[i].len - a->slots[i].done,
+                      offset, i)
+        : uring_read(a->ring, a->fd, p, BUFFER_SIZE - a->slots[i].done, offset,
+                     i);
+    if (r != 0)
+        a->slots[i].busy = false;
+    return r;
+}
+
+/* Wait for a request to complete and account for it. */
+static int aio_reap(aio_t *a, bool write) {
+    uint64_t tag;
+    int res;
+    if (uring_wait(a->ring, &tag, &res) != 0) {
+        /* Nothing more can be waited for, so give up on everything. */
+        for (size_t i = 0; i < QUEUE_DEPTH; i++)
+            a->slots[i].busy = false;
+        return -1;
+    }
+    assert(tag < QUEUE_DEPTH);
+    size_t i = (size_t)tag;
+
+    if (res == -EINTR || res == -EAGAIN)
+        return aio_submit(a, i, write);
+    a->slots[i].busy = false;
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+
+    a->slots[i].done += (size_t)res;
+    size_t want = write ? a->slots[i].len : BUFFER_SIZE;
+    /* A read returning nothing is the end of the file. Otherwise, continue a
+     * short transfer.
+     */
+    if (res > 0 && a->slots[i].done < want)
+        return aio_submit(a, i, write);
+    if (res == 0 && write) {
+        errno = EIO;
+        return -1;
+    }
+    /* A written slot is free to be filled again. */
+    if (write)
+        a->slots[i].len = 0;
+    return 0;
+}
+
+/* Wait for every request in flight, returning whether they all succeeded. */
+static bool aio_drain(aio_t *a, bool write) {
+    bool ok = true;
+    for (size_t i = 0; i < QUEUE_DEPTH; i++) {
+        while (a->slots[i].busy) {
+            if (aio_reap(a, write) != 0)
+                ok = false;
+        }
+    }
+    return ok;
+}
+
+static int aio_read_next(aio_t *a, size_t i) {
+    a->slots[i].offset = a->offset;
+    a->slots[i].done = 0;
+    a->offset += BUFFER_SIZE;
+    return aio_submit(a, i, false);
+}
+
+static ssize_t aio_read(void *cookie, char *buf, size_t size) {
+    aio_t *a = cookie;
+
+    for (;;) {
+        if (a->failed) {
+            errno = EIO;
+            return -1;
+        }
+
+        size_t i = a->current;
+        if (a->slots[i].busy) {
+            if (aio_reap(a, false) != 0)
+                a->failed = true;
+            continue;
+        }
+
+        if (a->pos < a->slots[i].done) {
+            size_t n = a->slots[i].done - a->pos;
+            if (n > size)
+                n = size;
+            memcpy(buf, a->slots[i].data + a->pos, n);
+            a->pos += n;
+            return (ssize_t)n;
+        }
+
+        /* A partial slot was the end of the file. */
+        if (a->slots[i].done < BUFFER_SIZE)
+            return 0;
+
+        /* Otherwise reuse the slot to read further ahead and move on. */
+        if (aio_read_next(a, i) != 0) {
+            a->failed = true;
+            continue;
+        }
+        a->current = (i + 1) % QUEUE_DEPTH;
+        a->pos = 0;
+    }
+}
+
+static int aio_reader_close(void *cookie) {
+    aio_t *a = cookie;
+    aio_drain(a, false);
+    int r = fclose(a->f);
+    aio_free(a);
+    return r;
+}
+
+static ssize_t aio_write(void *cookie, const char *buf, size_t size) {
+    aio_t *a = cookie;
+
+    size_t written = 0;
+    while (written < size) {
+        size_t i = a->current;
+        if (a->slots[i].busy && aio_reap(a, true) != 0)
+            a->failed = true;
+        if (a->failed) {
+            errno = EIO;
+            return (ssize_t)written;
+        }
+        if (a->slots[i].busy)
+            continue;
+
+        size_t n = BUFFER_SIZE - a->slots[i].len;
+        if (n > size - written)
+            n = size - written;
+        memcpy(a->slots[i].data + a->slots[i].len, buf + written, n);
+        a->slots[i].len += n;
+        written += n;
+
+        if (a->slots[i].len == BUFFER_SIZE) {
+            a->slots[i].offset = a->offset;
+            a->slots[i].done = 0;
+            a->offset += BUFFER_SIZE;
+            if (aio_submit(a, i, true) != 0) {
+                a->failed = true;
+                continue;
+            }
+            /* The next slot's previous write is left to complete until we
+             * actually need it.
+             */
+            a->current = (i + 1) % QUEUE_DEPTH;
+        }
+    }
+    return (ssize_t)size;
+}
+
+static int aio_writer_close(void *cookie) {
+    aio_t *a = cookie;
+
+    size_t i = a->current;
+    bool ok = !a->failed;
+    if (ok && !a->slots[i].busy && a->slots[i].len > 0) {
+        a->slots[i].offset = a->offset;
+        a->slots[i].done = 0;
+        a->offset += (off_t)a->slots[i].len;
+        ok = aio_submit(a, i, true) == 0;
+    }
+    if (!aio_drain(a, true))
+        ok = false;
+
+    /* Leave the file position where sequential writes would have. */
+    if (lseek(a->fd, a->offset, SEEK_SET) == (off_t)-1)
+        ok = false;
+    if (fclose(a->f) != 0)
+        ok = false;
+    aio_free(a);
+    return ok ? 0 : EOF;
+}
+
+static FILE *aio_reader(FILE *in, off_t offset) {
+    aio_t *a = aio_new(in, offset);
+    if (a == NULL)
+        return NULL;
+
+    /* Start reading into every slot. */
+    for (size_t i = 0; i < QUEUE_DEPTH; i++) {
+        if (aio_read_next(a, i) != 0) {
+            aio_drain(a, false);
+            aio_free(a);
+            return NULL;
+        }
+    }
+
+    FILE *f = fopencookie(a, "r", (cookie_io_functions_t){
+        .read = aio_read, .close = aio_reader_close });
+    if (f == NULL) {
+        aio_drain(a, false);
+        aio_free(a);
+    }
+    return f;
+}
+
+static FILE *aio_writer(FILE *out) {
+    /* Writes to an append-only file ignore their offsets, so would land in the
+     * order they complete.
+     */
+    int flags = fcntl(fileno(out), F_GETFL);
+    if (flags == -1 || (flags & O_APPEND))
+        return NULL;
+
+    aio_t *a = aio_new(out, ftello(out));
+    if (a == NULL)
+        return NULL;
+
+    FILE *f = fopencookie(a, "w", (cookie_io_functions_t){
+        .write = aio_write, .close = aio_writer_close });
+    if (f == NULL)
+        aio_free(a);
+    return f;
+}
+
+static stream_t *stream_new(FILE *f, codec_t codec) {
+    stream_t *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->codec = codec;
+    s->f = f;
+    if (queue_init(&s->queue) != 0) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+/* Start the codec thread, releasing `s` on failure. */
+static int stream_start(stream_t *s, void *(*run)(void*)) {
+    int err = pthread_create(&s->thread, NULL, run, s);
+    if (err != 0) {
+        queue_destroy(&s->queue);
+        free(s);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+FILE *codec_reader(FILE *in) {
+    assert(in != NULL);
+
+    /* Interactive input is read a line at a time, so reading ahead would only
+     * delay it.
+     */
+    if (isatty(fileno(in)))
+        return in;
+
+    /* Both gzip and zstd headers start with a byte that cannot begin valid
+     * text input, so plain input needs only one byte of lookahead.
+     */
+    static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+    int c = getc(in);
+    if (c == EOF)
+        return ferror(in) ? NULL : in;
+
+    stream_t *s = stream_new(in, CODEC_NONE);
+    if (s == NULL)
+        return NULL;
+    if (c != 0x1f && c != zstd_magic[0]) {
+        ungetc(c, in);
+    } else {
+        s->prefix[0] = (unsigned char)c;
+        s->prefix_len = 1 + fread(s->prefix + 1, 1, sizeof(s->prefix) - 1, in);
+    }
+    if (s->prefix_len >= 2 && s->prefix[0] == 0x1f && s->prefix[1] == 0x8b) {
+        s->codec = CODEC_GZIP;
+    } else if (s->prefix_len == sizeof(zstd_magic) &&
+               memcmp(s->prefix, zstd_magic, sizeof(zstd_magic)) == 0) {
+        s->codec = CODEC_ZSTD;
+    }
+
+    if (!codec_available(s->codec)) {
+        queue_destroy(&s->queue);
+        free(s);
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    /* Plain regular files are read ahead by the kernel rather than a thread,
+     * starting over from the bytes we have already looked at.
+     */
+    if (s->codec == CODEC_NONE) {
+        off_t offset = ftello(in);
+        FILE *f = offset < 0 ? NULL
+                             : aio_reader(in, offset - (off_t)s->prefix_len);
+        if (f != NULL) {
+            queue_destroy(&s->queue);
+            free(s);
+            return f;
+        }
+    }
+
+    if (stream_start(s, run_decompressor) != 0)
+        return NULL;
+
+    FILE *f = fopencookie(s, "r", (cookie_io_functions_t){
+        .read = reader_read, .close = reader_close });
+    if (f == NULL) {
+        reader_close(s);
+        return NULL;
+    }
+    return f;
+}
+
+FILE *codec_writer(FILE *out, codec_t codec) {
+    assert(out != NULL);
+
+    if (!codec_available(codec)) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    if (codec == CODEC_NONE) {
+        if (isatty(fileno(out)))
+            return out;
+        FILE *f = aio_writer(out);
+        if (f != NULL)
+            return f;
+    }
+
+    stream_t *s = stream_new(out, codec);
+    if (s == NULL)
+        return NULL;
+    if (stream_start(s, run_compressor) != 0)
+        return NULL;
+
+    FILE *f = fopencookie(s, "w", (cookie_io_functions_t){
+        .write = writer_write, .close = writer_close });
+    if (f == NULL) {
+        queue_fail(&s->queue);
+        pthread_join(s->thread, NULL);
+        queue_destroy(&s->queue);
+        free(s);
+        return NULL;
+    }
+    return f;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Transparent compression and asynchronous I/O of input and output.
+ * Compressed input is detected by its header and decompressed on a separate
+ * thread ahead of being read, while compressed output is produced on a
+ * separate thread behind it being written. The threads exchange large buffers
+ * through bounded queues, so translation only waits on the codecs when they
+ * cannot keep up.
+ *
+ * Plain regular files are instead read ahead and written behind through
+ * io_uring where the kernel supports it, with several large buffers in flight
+ * at once. Other plain input and output, such as pipes, falls back to the same
+ * threads as the codecs, just copying.
+ *
+ * Each codec is only available if its library was found at build time.
+ */
+
+typedef enum {
+    CODEC_NONE,
+    CODEC_GZIP,
+    CODEC_ZSTD,
+} codec_t;
+
+/* The codec implied by a file name's extension. */
+codec_t codec_from_name(const char *path);
+
+/* Whether `codec` can be used in this build. */
+bool codec_available(codec_t codec);
+
+/* Wrap `in` to decompress it if it is compressed and read it ahead. Returns
+ * `in` itself if it is a terminal, or `NULL` with `errno` set on failure,
+ * including `ENOTSUP` if the codec it uses is unavailable. Closing the returned
+ * stream closes `in`.
+ */
+FILE *codec_reader(FILE *in);
+
+/* Wrap `out` to compress everything written to it with `codec`, if any, and
+ * write it behind. Returns `out` itself for uncompressed output to a terminal,
+ * or `NULL` with `errno` set on failure. Closing the returned stream finishes
+ * any compressed output and closes `out`, failing if anything could not be
+ * written.
+ */
+FILE *codec_writer(FILE *out, codec_t codec);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Minimal SHA-256 implementation (FIPS 180-4), used for content addressing the
+ * output cache.
+ */
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+} sha256_t;
+
+void sha256_init(sha256_t *h);
+void sha256_update(sha256_t *h, const void *data, size_t len);
+
+/* Finish the hash and write it as 64 lowercase hex digits and a NUL. */
+void sha256_final(sha256_t *h, char hex[65]);
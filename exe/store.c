@@ -0,0 +1,232 @@
+/* Command line interface to translation stores.
+ *
+ *   utf8totex-store --update [--env ENV]... [options] STORE < records
+ *   utf8totex-store [--env ENV] STORE KEY...
+ *
+ * The first form creates or updates STORE from records of the form KEY, a tab
+ * and UTF-8 text, one per line. The second prints the translation of each KEY
+ * for a single environment, one per line.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utf8totex/utf8totex.h"
+
+static const struct {
+    const char *name;
+    int font_encoding;
+} encodings[] = {
+    {"ot1", UTF8TOTEX_FE_OT1}, {"ot2", UTF8TOTEX_FE_OT2},
+    {"ot3", UTF8TOTEX_FE_OT3}, {"ot4", UTF8TOTEX_FE_OT4},
+    {"ot6", UTF8TOTEX_FE_OT6}, {"t1", UTF8TOTEX_FE_T1},
+    {"t2a", UTF8TOTEX_FE_T2A}, {"t2b", UTF8TOTEX_FE_T2B},
+    {"t2c", UTF8TOTEX_FE_T2C}, {"t3", UTF8TOTEX_FE_T3},
+    {"t4", UTF8TOTEX_FE_T4}, {"t5", UTF8TOTEX_FE_T5},
+    {"ts1", UTF8TOTEX_FE_TS1}, {"ts3", UTF8TOTEX_FE_TS3},
+    {"x2", UTF8TOTEX_FE_X2}, {"oml", UTF8TOTEX_FE_OML},
+    {"oms", UTF8TOTEX_FE_OMS}, {"omx", UTF8TOTEX_FE_OMX},
+};
+
+/* Parse an environment of the form "t1" or "t1+textcomp". */
+static int parse_env(const char *s, utf8totex_environment_t *env) {
+    *env = UTF8TOTEX_DEFAULT_ENVIRONMENT;
+    size_t len = strcspn(s, "+");
+    if (s[len] != '\0') {
+        if (strcmp(s + len, "+textcomp") != 0)
+            return -1;
+        env->textcomp = true;
+    }
+    for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++) {
+        if (strlen(encodings[i].name) == len &&
+            strncmp(encodings[i].name, s, len) == 0) {
+            env->font_encoding = encodings[i].font_encoding;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static const char *error_message(utf8totex_char_t error) {
+    return error == UTF8TOTEX_EOF ? "resource allocation failure" :
+           error == UTF8TOTEX_INVALID ? "invalid UTF-8 character" :
+           error == UTF8TOTEX_UNSUPPORTED ? "unsupported UTF-8 character" :
+           error == UTF8TOTEX_BAD_MODIFIER ? "bad modifier character" :
+           error == UTF8TOTEX_BAD_LITERAL ? "non-ASCII character in TeX literal" :
+           "unknown";
+}
+
+static int lookup(const char *path, utf8totex_environment_t env, char **keys,
+        size_t n) {
+    utf8totex_store_t *s = utf8totex_store_open(path);
+    if (s == NULL) {
+        fprintf(stderr, "failed to open %s: %s\n", path, errno == ESTALE
+            ? "written by a different version, needs updating"
+            : strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < n; i++) {
+        size_t len;
+        utf8totex_char_t error;
+        const char *t = utf8totex_store_lookup(s, keys[i], env, &len, &error);
+        if (t == NULL) {
+            if (errno == EILSEQ) {
+                fprintf(stderr, "%s: %s\n", keys[i], error_message(error));
+            } else {
+                fprintf(stderr, "%s: not found\n", keys[i]);
+            }
+            result = EXIT_FAILURE;
+            continue;
+        }
+        if (fwrite(t, 1, len, stdout) != len || putchar('\n') == EOF) {
+            fprintf(stderr, "failed to write output\n");
+            result = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    utf8totex_store_free(s);
+    return result;
+}
+
+int main(int argc, char **argv) {
+
+    FILE *in = NULL;
+    int _update = 0;
+    int _fuzzy = 0;
+    int _elide = UTF8TOTEX_ELIDE_NONE;
+    int _coalesce_math = 0;
+    long line_limit = 0;
+    utf8totex_environment_t envs[sizeof(encodings) / sizeof(encodings[0]) * 2];
+    size_t envs_len = 0;
+    while (true) {
+        struct option options[] = {
+            {"input", required_argument, 0, 'i'},
+            {"env", required_argument, 0, 'e'},
+            {"line-limit", required_argument, 0, 'l'},
+            {"update", no_argument, &_update, 1},
+            {"fuzzy", no_argument, &_fuzzy, 1},
+            {"no-fuzzy", no_argument, &_fuzzy, 0},
+            {"coalesce-math", no_argument, &_coalesce_math, 1},
+            {"elide-braces", no_argument, &_elide, (int)UTF8TOTEX_ELIDE_SYMBOLS},
+            {"elide-all-braces", no_argument, &_elide, (int)UTF8TOTEX_ELIDE_ALL},
+            {0},
+        };
+
+        int index;
+        int c = getopt_long(argc, argv, "i:", options, &index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+
+            case 0:
+                break;
+
+            case 'i':
+                if (in != NULL)
+                    fclose(in);
+                in = fopen(optarg, "r");
+                if (in == NULL) {
+                    fprintf(stderr, "failed to open %s for reading\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'e':
+                if (envs_len == sizeof(envs) / sizeof(envs[0])) {
+                    fprintf(stderr, "too many environments\n");
+                    return EXIT_FAILURE;
+                }
+                if (parse_env(optarg, &envs[envs_len]) != 0) {
+                    fprintf(stderr, "invalid environment %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                envs_len++;
+                break;
+
+            case 'l': {
+                char *end;
+                line_limit = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || line_limit < 0) {
+                    fprintf(stderr, "invalid line limit %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+
+            case '?':
+                fprintf(stderr, "Usage: %s --update [options...] STORE\n"
+                                "       %s [--env ENV] STORE KEY...\n"
+                                " --update        Create or update STORE from records of a\n"
+                                "                 key, a tab and text, one per line. A key\n"
+                                "                 on its own deletes that record.\n"
+                                " --input FILE\n"
+                                " -i FILE         Read records from FILE instead of stdin\n"
+                                " --env ENV       Translate for ENV, a font encoding such\n"
+                                "                 as t1, optionally followed by +textcomp.\n"
+                                "                 May be given more than once when\n"
+                                "                 updating.\n"
+                                " --line-limit N  Break output lines longer than N bytes\n"
+                                "                 where possible (default 0, no limit)\n"
+                                " --fuzzy         Enable fuzzy mode\n"
+                                " --no-fuzzy      Disable fuzzy mode\n"
+                                " --elide-braces  Drop unnecessary braces around symbols\n"
+                                " --elide-all-braces\n"
+                                "                 Drop unnecessary braces around symbols\n"
+                                "                 and accented letters\n"
+                                " --coalesce-math Join adjacent math mode characters into\n"
+                                "                 one math group\n"
+                                , argv[0], argv[0]);
+                return EXIT_FAILURE;
+
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "no store given\n");
+        return EXIT_FAILURE;
+    }
+    const char *path = argv[optind++];
+    if (envs_len == 0)
+        envs[envs_len++] = UTF8TOTEX_DEFAULT_ENVIRONMENT;
+
+    if (!_update) {
+        if (envs_len > 1) {
+            fprintf(stderr, "only one environment can be looked up at a "
+                "time\n");
+            return EXIT_FAILURE;
+        }
+        return lookup(path, envs[0], argv + optind, (size_t)(argc - optind));
+    }
+
+    if (optind != argc) {
+        fprintf(stderr, "unexpected argument %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    utf8totex_options_t options = UTF8TOTEX_DEFAULT_OPTIONS;
+    options.fuzzy = !!_fuzzy;
+    options.elide_braces = _elide;
+    options.coalesce_math = !!_coalesce_math;
+    options.line_limit = (size_t)line_limit;
+
+    int result = EXIT_SUCCESS;
+    if (utf8totex_store_update(path, in == NULL ? stdin : in, options, envs,
+            envs_len) != 0) {
+        fprintf(stderr, "failed to update %s: %s\n", path, strerror(errno));
+        result = EXIT_FAILURE;
+    }
+    if (in != NULL)
+        fclose(in);
+    return result;
+}
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE /* syscall */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct uring {
+    int fd;
+
+    /* Submission queue. We are its only producer, so the tail need only be
+     * read back from our own writes.
+     */
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    /* Completion queue. We are its only consumer. */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+uring_t *uring_new(unsigned entries) {
+    uring_t *u = calloc(1, sizeof(*u));
+    if (u == NULL)
+        return NULL;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0) {
+        free(u);
+        return NULL;
+    }
+
+    /* `IORING_OP_READ` and `IORING_OP_WRITE` arrived alongside this. */
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        close(u->fd);
+        free(u);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes +
+                      p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size)
+            u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = u->sq_ring_size;
+    }
+
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            u->cq_ring = NULL;
+            goto fail;
+        }
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto fail;
+    }
+
+    char *sq = u->sq_ring;
+    u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    char *cq = u->cq_ring;
+    u->cq_head = (unsigned*)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return u;
+
+fail:;
+    int err = errno;
+    uring_free(u);
+    errno = err;
+    return NULL;
+}
+
+static int submit(uring_t *u, int op, int fd, const void *buf, size_t len,
+        off_t offset, uint64_t tag) {
+    assert(len <= UINT32_MAX);
+
+    unsigned tail = *u->sq_tail;
+    unsigned index = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->off = (uint64_t)offset;
+    sqe->user_data = tag;
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        long r = syscall(__NR_io_uring_enter, u->fd, 1, 0, 0, NULL, 0);
+        if (r >= 0)
+            return 0;
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+int uring_read(uring_t *u, int fd, void *buf, size_t len, off_t offset,
+        uint64_t tag) {
+    assert(u != NULL);
+    return submit(u, IORING_OP_READ, fd, buf, len, offset, tag);
+}
+
+int uring_write(uring_t *u, int fd, const void *buf, size_t len, off_t offset,
+        uint64_t tag) {
+    assert(u != NULL);
+    return submit(u, IORING_OP_WRITE, fd, buf, len, offset, tag);
+}
+
+int uring_wait(uring_t *u, uint64_t *tag, int *res) {
+    assert(u != NULL);
+    assert(tag != NULL);
+    assert(res != NULL);
+
+    for (;;) {
+        unsigned head = *u->cq_head;
+        if (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            *tag = cqe->user_data;
+            *res = cqe->res;
+            __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+
+        long r = syscall(__NR_io_uring_enter, u->fd, 0, 1,
+            IORING_ENTER_GETEVENTS, NULL, 0);
+        if (r < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
+void uring_free(uring_t *u) {
+    if (u == NULL)
+        return;
+    if (u->sqes != NULL)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != NULL && u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+    free(u);
+}
+
+#else
+
+/* Without the kernel headers, always fall back to blocking I/O. */
+
+uring_t *uring_new(unsigned entries) {
+    (void)entries;
+    errno = ENOSYS;
+    return NULL;
+}
+
+int uring_read(uring_t *u, int fd, void *buf, size_t len, off_t offset,
+        uint64_t tag) {
+    (void)u; (void)fd; (void)buf; (void)len; (void)offset; (void)tag;
+    assert(!"unreachable");
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_write(uring_t *u, int fd, const void *buf, size_t len, off_t offset,
+        uint64_t tag) {
+    (void)u; (void)fd; (void)buf; (void)len; (void)offset; (void)tag;
+    assert(!"unreachable");
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_wait(uring_t *u, uint64_t *tag, int *res) {
+    (void)u; (void)tag; (void)res;
+    assert(!"unreachable");
+    errno = ENOSYS;
+    return -1;
+}
+
+void uring_free(uring_t *u) {
+    (void)u;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* A minimal io_uring instance, driven through the system calls directly so as
+ * not to depend on liburing. Only reads and writes are supported. Requests
+ * are submitted as soon as they are queued and their completions are waited
+ * for one at a time.
+ */
+
+typedef struct uring uring_t;
+
+/* Create an instance able to have `entries` requests in flight. Returns `NULL`
+ * with `errno` set if io_uring is unavailable, in which case the caller should
+ * fall back to blocking I/O.
+ */
+uring_t *uring_new(unsigned entries);
+
+/* Start reading `len` bytes from `offset` in `fd` into `buf`, to be identified
+ * by `tag` on completion.
+ */
+int uring_read(uring_t *u, int fd, void *buf, size_t len, off_t offset,
+    uint64_t tag);
+
+/* Start writing `len` bytes from `buf` to `offset` in `fd`, to be identified by
+ * `tag` on completion.
+ */
+int uring_write(uring_t *u, int fd, const void *buf, size_t len, off_t offset,
+    uint64_t tag);
+
+/* Wait for a request to complete, returning `0` with its tag and its result
+ * (bytes transferred or a negated `errno` value) or `-1` on error.
+ */
+int uring_wait(uring_t *u, uint64_t *tag, int *res);
+
+void uring_free(uring_t *u);
@@ -1,25 +1,315 @@
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <locale.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "cache.h"
+#include "codec.h"
+#include "sha256.h"
 #include "utf8totex/utf8totex.h"
 
+static const char *error_message(utf8totex_char_t error) {
+    return error == UTF8TOTEX_EOF ? "resource allocation failure" :
+           error == UTF8TOTEX_INVALID ? "invalid UTF-8 character" :
+           error == UTF8TOTEX_UNSUPPORTED ? "unsupported UTF-8 character" :
+           error == UTF8TOTEX_BAD_MODIFIER ? "bad modifier character" :
+           error == UTF8TOTEX_BAD_LITERAL ? "non-ASCII character in TeX literal" :
+           "unknown";
+}
+
+static void print_stats(const utf8totex_stats_t *stats, FILE *f) {
+    fprintf(f, "{\n"
+               "  \"bytes_in\": %" PRIu64 ",\n"
+               "  \"bytes_out\": %" PRIu64 ",\n"
+               "  \"code_points\": {\n"
+               "    \"ascii\": %" PRIu64 ",\n"
+               "    \"sequence\": %" PRIu64 ",\n"
+               "    \"modifier\": %" PRIu64 ",\n"
+               "    \"unsupported\": %" PRIu64 ",\n"
+               "    \"invalid\": %" PRIu64 "\n"
+               "  },\n"
+               "  \"top_unsupported\": [",
+        stats->bytes_in, stats->bytes_out, stats->ascii, stats->sequence,
+        stats->modifier, stats->unsupported, stats->invalid);
+    const char *sep = "";
+    for (size_t i = 0; i < UTF8TOTEX_STATS_TOP; i++) {
+        if (stats->top_unsupported[i].count == 0)
+            break;
+        fprintf(f, "%s\n    {\"code_point\": \"U+%04" PRIX32 "\", \"count\": %"
+            PRIu64 "}", sep, stats->top_unsupported[i].code_point,
+            stats->top_unsupported[i].count);
+        sep = ",";
+    }
+    fprintf(f, "%s]\n}\n", *sep == '\0' ? "" : "\n  ");
+}
+
+/* Split a comma-separated list in place into a `NULL`-terminated array. */
+static const char **parse_list(char *s) {
+    size_t n = 1;
+    for (const char *p = s; *p != '\0'; p++)
+        n += *p == ',';
+    const char **list = calloc(n + 1, sizeof(list[0]));
+    if (list == NULL)
+        return NULL;
+    if (*s == '\0')
+        return list;
+    for (size_t i = 0; i < n; i++) {
+        list[i] = s;
+        s += strcspn(s, ",");
+        if (*s == ',')
+            *s++ = '\0';
+    }
+    return list;
+}
+
+/* Write a source map as one line per entry of input offset, input length,
+ * output offset, output length and whether the entry is a run of unchanged
+ * input.
+ */
+static int print_srcmap(const utf8totex_srcmap_t *srcmap, FILE *f) {
+    size_t len;
+    const utf8totex_srcmap_entry_t *e = utf8totex_srcmap_entries(srcmap, &len);
+    for (size_t i = 0; i < len; i++) {
+        if (fprintf(f, "%zu %" PRIu32 " %zu %" PRIu32 " %d\n", e[i].in,
+                    e[i].in_len, e[i].out, e[i].out_len, (int)e[i].identity) < 0)
+            return -1;
+    }
+    return fflush(f) == 0 ? 0 : -1;
+}
+
+/* Translate all of `in` to `out`, returning an exit status. If `required` is
+ * not `NULL`, it is extended with the environment the output needs.
+ */
+static int translate(FILE *in, FILE *out, utf8totex_options_t options,
+        bool bibtex_mode, long threads, utf8totex_environment_t *required) {
+
+    /* Fuzzy mode's state, such as being inside a verbatim environment or
+     * display math, carries across lines, so it too needs the whole input at
+     * once rather than a line at a time.
+     */
+    if ((threads >= 0 || options.fuzzy) && !bibtex_mode) {
+        /* Slurp the entire input. It should not contain any NULs. */
+        char *all = NULL;
+        size_t size;
+        if (getdelim(&all, &size, '\0', in) == -1 && ferror(in)) {
+            fprintf(stderr, "failed to read input\n");
+            free(all);
+            return EXIT_FAILURE;
+        }
+
+        utf8totex_char_t error;
+        int r = all == NULL ? 0 :
+                required != NULL ? utf8totex_fputs_auto(all, options, out,
+                                     required, &error) :
+                threads >= 0 ? utf8totex_fputs_parallel(all, options,
+                                 (unsigned)threads, out, &error) :
+                utf8totex_fputs_opt(all, options, out, &error);
+        free(all);
+        if (r == EOF) {
+            fprintf(stderr, "failed to write output: %s\n",
+                error_message(error));
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    utf8totex_bibtex_t *bibtex = NULL;
+    if (bibtex_mode) {
+        bibtex = utf8totex_bibtex_new_opt(options);
+        if (bibtex == NULL) {
+            fprintf(stderr, "failed to create BibTeX scanner\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    char *line = NULL;
+    size_t n;
+    unsigned int lineno = 1;
+    while (getline(&line, &n, in) != -1) {
+        utf8totex_char_t error;
+        int r = bibtex != NULL
+            ? utf8totex_bibtex_fputs(bibtex, line, out, &error)
+            : required != NULL
+            ? utf8totex_fputs_auto(line, options, out, required, &error)
+            : utf8totex_fputs_opt(line, options, out, &error);
+        if (r == EOF) {
+            fprintf(stderr, "failed to write line %u to output: %s\n", lineno,
+                error_message(error));
+            utf8totex_bibtex_free(bibtex);
+            free(line);
+            return EXIT_FAILURE;
+        }
+        lineno++;
+    }
+    free(line);
+
+    if (bibtex != NULL) {
+        utf8totex_char_t error;
+        if (utf8totex_bibtex_finish(bibtex, out, &error) == EOF) {
+            fprintf(stderr, "failed to complete BibTeX output: %s\n",
+                error == UTF8TOTEX_INVALID ? "unterminated field value" :
+                error_message(error));
+            utf8totex_bibtex_free(bibtex);
+            return EXIT_FAILURE;
+        }
+        utf8totex_bibtex_free(bibtex);
+    }
+
+    if (ferror(in)) {
+        fprintf(stderr, "failed to read line from input\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* As for `translate`, but consulting and populating the output cache in
+ * `cache_dir` first.
+ */
+static int translate_cached(const char *cache_dir, const char *map_path,
+        FILE *in, FILE *out, utf8totex_options_t options, bool bibtex_mode,
+        long threads) {
+
+    /* We need all the input up front to compute its key. */
+    char *all = NULL;
+    size_t size;
+    ssize_t len = getdelim(&all, &size, '\0', in);
+    if (len == -1) {
+        if (ferror(in)) {
+            fprintf(stderr, "failed to read input\n");
+            free(all);
+            return EXIT_FAILURE;
+        }
+        len = 0;
+    }
+
+    /* Everything that can influence the output goes into the key. */
+    sha256_t h;
+    sha256_init(&h);
+    char params[128];
+    int params_len = snprintf(params, sizeof(params),
+        "utf8totex %s fe=%d textcomp=%d fuzzy=%d elide=%d math=%d lines=%zu "
+        "bibtex=%d",
+        utf8totex_version(), (int)options.env.font_encoding,
+        (int)options.env.textcomp, (int)options.fuzzy,
+        (int)options.elide_braces, (int)options.coalesce_math,
+        options.line_limit, (int)bibtex_mode);
+    sha256_update(&h, params, (size_t)params_len + 1);
+    if (options.verbatim == NULL) {
+        sha256_update(&h, "verbatim=default", strlen("verbatim=default") + 1);
+    } else {
+        sha256_update(&h, "verbatim=", strlen("verbatim=") + 1);
+        for (const char *const *v = options.verbatim; *v != NULL; v++)
+            sha256_update(&h, *v, strlen(*v) + 1);
+    }
+    if (map_path != NULL) {
+        FILE *m = fopen(map_path, "r");
+        if (m == NULL) {
+            fprintf(stderr, "failed to open %s for reading\n", map_path);
+            free(all);
+            return EXIT_FAILURE;
+        }
+        char buffer[BUFSIZ];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), m)) > 0)
+            sha256_update(&h, buffer, n);
+        fclose(m);
+    }
+    sha256_update(&h, all == NULL ? "" : all, (size_t)len);
+    char key[65];
+    sha256_final(&h, key);
+
+    /* Serve from the cache if we can. */
+    int fd = cache_open(cache_dir, key);
+    if (fd != -1) {
+        int r = cache_send(fd, out);
+        close(fd);
+        free(all);
+        if (r != 0) {
+            fprintf(stderr, "failed to write output\n");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    /* Otherwise translate into a new cache entry and then send that. */
+    cache_entry_t entry;
+    if (cache_create(&entry, cache_dir) != 0) {
+        /* A broken cache should not stop us translating. */
+        FILE *input = fmemopen(all == NULL ? "" : all, (size_t)len, "r");
+        int result = input == NULL ? EXIT_FAILURE
+                                   : translate(input, out, options, bibtex_mode,
+                                               threads, NULL);
+        if (input != NULL)
+            fclose(input);
+        free(all);
+        return result;
+    }
+
+    FILE *input = fmemopen(all == NULL ? "" : all, (size_t)len, "r");
+    int result = input == NULL ? EXIT_FAILURE
+                               : translate(input, entry.f, options, bibtex_mode,
+                                           threads, NULL);
+    if (input != NULL)
+        fclose(input);
+    free(all);
+
+    if (fflush(entry.f) != 0 || cache_send(fileno(entry.f), out) != 0) {
+        fprintf(stderr, "failed to write output\n");
+        result = EXIT_FAILURE;
+    }
+
+    /* Only keep successful translations. */
+    if (result == EXIT_SUCCESS) {
+        cache_commit(&entry, key);
+    } else {
+        cache_abandon(&entry);
+    }
+    return result;
+}
+
 int main(int argc, char **argv) {
 
     setlocale(LC_ALL, NULL);
 
     FILE *in = NULL;
-    FILE *out = NULL;
+    const char *out_path = NULL;
 
     int _fuzzy = 0;
     int _encoding = UTF8TOTEX_FE_OT1;
     int _textcomp = 0;
+    int _bibtex = 0;
+    int _elide = UTF8TOTEX_ELIDE_NONE;
+    int _coalesce_math = 0;
+    int _stats = 0;
+    long threads = -1;
+    /* Well within TeX's input buffer, which is typically 200000 bytes. */
+    long line_limit = 1000;
+    const char *map_path = NULL;
+    const char *cache_dir = NULL;
+    FILE *srcmap_out = NULL;
+    FILE *preamble_out = NULL;
+    FILE *translit_out = NULL;
+    const char **verbatim = NULL;
+    utf8totex_map_t *map = NULL;
     while (true) {
         struct option options[] = {
             {"input", required_argument, 0, 'i'},
             {"output", required_argument, 0, 'o'},
+            {"map", required_argument, 0, 'm'},
+            {"threads", required_argument, 0, 'j'},
+            {"cache-dir", required_argument, 0, 'c'},
+            {"source-map", required_argument, 0, 's'},
+            {"auto", required_argument, 0, 'a'},
+            {"line-limit", required_argument, 0, 'l'},
+            {"translit", required_argument, 0, 't'},
+            {"verbatim", required_argument, 0, 'v'},
             {"ot1", no_argument, &_encoding, (int)UTF8TOTEX_FE_OT1},
             {"ot2", no_argument, &_encoding, (int)UTF8TOTEX_FE_OT2},
             {"ot3", no_argument, &_encoding, (int)UTF8TOTEX_FE_OT3},
@@ -41,11 +331,16 @@ int main(int argc, char **argv) {
             {"textcomp", no_argument, &_textcomp, 1},
             {"fuzzy", no_argument, &_fuzzy, 1},
             {"no-fuzzy", no_argument, &_fuzzy, 0},
+            {"coalesce-math", no_argument, &_coalesce_math, 1},
+            {"bibtex", no_argument, &_bibtex, 1},
+            {"stats", no_argument, &_stats, 1},
+            {"elide-braces", no_argument, &_elide, (int)UTF8TOTEX_ELIDE_SYMBOLS},
+            {"elide-all-braces", no_argument, &_elide, (int)UTF8TOTEX_ELIDE_ALL},
             {0},
         };
 
         int index;
-        int c = getopt_long(argc, argv, "i:o:", options, &index);
+        int c = getopt_long(argc, argv, "i:o:j:", options, &index);
 
         if (c == -1)
             break;
@@ -66,24 +361,133 @@ int main(int argc, char **argv) {
                 break;
 
             case 'o':
-                if (out != NULL)
-                    fclose(out);
-                out = fopen(optarg, "w");
-                if (out == NULL) {
+                out_path = optarg;
+                break;
+
+            case 'm': {
+                utf8totex_map_free(map);
+                unsigned error_line = 0;
+                map = utf8totex_map_load(optarg, &error_line);
+                map_path = optarg;
+                if (map == NULL) {
+                    if (error_line != 0) {
+                        fprintf(stderr, "syntax error in %s on line %u\n",
+                            optarg, error_line);
+                    } else {
+                        fprintf(stderr, "failed to load %s\n", optarg);
+                    }
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+
+            case 'j': {
+                char *end;
+                threads = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || threads < 0) {
+                    fprintf(stderr, "invalid thread count %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+
+            case 'c':
+                cache_dir = optarg;
+                break;
+
+            case 'l': {
+                char *end;
+                line_limit = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || line_limit < 0) {
+                    fprintf(stderr, "invalid line limit %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+
+            case 's':
+                if (srcmap_out != NULL)
+                    fclose(srcmap_out);
+                srcmap_out = fopen(optarg, "w");
+                if (srcmap_out == NULL) {
+                    fprintf(stderr, "failed to open %s for writing\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'a':
+                if (preamble_out != NULL)
+                    fclose(preamble_out);
+                preamble_out = fopen(optarg, "w");
+                if (preamble_out == NULL) {
                     fprintf(stderr, "failed to open %s for writing\n", optarg);
                     return EXIT_FAILURE;
                 }
                 break;
 
+            case 't':
+                if (translit_out != NULL)
+                    fclose(translit_out);
+                translit_out = fopen(optarg, "w");
+                if (translit_out == NULL) {
+                    fprintf(stderr, "failed to open %s for writing\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'v':
+                free(verbatim);
+                verbatim = parse_list(optarg);
+                if (verbatim == NULL) {
+                    fprintf(stderr, "out of memory\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+
             case '?':
                 fprintf(stderr, "Usage: %s options...\n"
                                 " --input FILE\n"
-                                " -i FILE         Read from FILE instead of stdin\n"
+                                " -i FILE         Read from FILE instead of stdin. gzip and\n"
+                                "                 zstd compressed input is decompressed.\n"
                                 " --output FILE\n"
-                                " -o FILE         Write to FILE instead of stdout\n"
+                                " -o FILE         Write to FILE instead of stdout, compressing\n"
+                                "                 if FILE ends in .gz or .zst\n"
+                                " --threads N\n"
+                                " -j N            Read the whole input at once and translate\n"
+                                "                 it using up to N threads (0 for one per CPU)\n"
+                                " --cache-dir DIR Reuse output from, and store output in,\n"
+                                "                 a cache in DIR\n"
+                                " --map FILE      Load additional character mappings from FILE\n"
+                                " --source-map FILE\n"
+                                "                 Write the byte ranges of input and output\n"
+                                "                 that correspond to each other to FILE\n"
+                                " --auto FILE     Only depend on as much of the environment\n"
+                                "                 given by the options below as the input\n"
+                                "                 needs, and write the preamble lines\n"
+                                "                 setting this up to FILE\n"
+                                " --line-limit N  Break output lines longer than N bytes\n"
+                                "                 where possible (default 1000, 0 for\n"
+                                "                 no limit)\n"
+                                " --translit FILE Write an ASCII transliteration of the\n"
+                                "                 input to FILE\n"
                                 " --textcomp      Assume \\usepackage{textcomp}\n"
                                 " --fuzzy         Enable fuzzy mode\n"
                                 " --no-fuzzy      Disable fuzzy mode\n"
+                                " --verbatim LIST In fuzzy mode, pass through the\n"
+                                "                 arguments of the macros (such as \\url)\n"
+                                "                 and bodies of the environments (such as\n"
+                                "                 verbatim) in the comma-separated LIST\n"
+                                "                 untouched\n"
+                                " --elide-braces  Drop unnecessary braces around symbols\n"
+                                " --elide-all-braces\n"
+                                "                 Drop unnecessary braces around symbols\n"
+                                "                 and accented letters\n"
+                                " --coalesce-math Join adjacent math mode characters into\n"
+                                "                 one math group\n"
+                                " --bibtex        Treat input as a BibTeX database and only\n"
+                                "                 translate field values\n"
+                                " --stats         Print translation statistics as JSON to\n"
+                                "                 stderr on exit\n"
                                 " --ot1\n"
                                 " --ot2\n"
                                 " --ot3\n"
@@ -114,42 +518,141 @@ int main(int argc, char **argv) {
     env.font_encoding = _encoding;
     if (_textcomp)
         env.textcomp = true;
-    bool fuzzy = !!_fuzzy;
+    utf8totex_options_t options = UTF8TOTEX_DEFAULT_OPTIONS;
+    options.fuzzy = !!_fuzzy;
+    options.env = env;
+    options.elide_braces = _elide;
+    options.coalesce_math = !!_coalesce_math;
+    options.line_limit = (size_t)line_limit;
+    options.map = map;
+    options.verbatim = verbatim;
+    utf8totex_stats_t stats = { 0 };
+    if (_stats) {
+        options.stats = &stats;
+        /* A cache hit would translate nothing to count. */
+        cache_dir = NULL;
+    }
+    utf8totex_srcmap_t *srcmap = NULL;
+    if (srcmap_out != NULL) {
+        if (_bibtex) {
+            fprintf(stderr, "--source-map cannot be used with --bibtex\n");
+            return EXIT_FAILURE;
+        }
+        srcmap = utf8totex_srcmap_new();
+        if (srcmap == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        options.srcmap = srcmap;
+        /* A cache hit would leave us with no map. */
+        cache_dir = NULL;
+    }
+    if (translit_out != NULL) {
+        if (_bibtex) {
+            fprintf(stderr, "--translit cannot be used with --bibtex\n");
+            return EXIT_FAILURE;
+        }
+        options.translit = translit_out;
+        /* Nor would a cache hit give us a transliteration. */
+        cache_dir = NULL;
+    }
+    utf8totex_environment_t required = UTF8TOTEX_DEFAULT_ENVIRONMENT;
+    if (preamble_out != NULL) {
+        if (_bibtex) {
+            fprintf(stderr, "--auto cannot be used with --bibtex\n");
+            return EXIT_FAILURE;
+        }
+        /* Nor would a cache hit tell us what the output needs. */
+        cache_dir = NULL;
+    }
 
     if (in == NULL)
         in = stdin;
+    FILE *decompressed = codec_reader(in);
+    if (decompressed == NULL) {
+        fprintf(stderr, "failed to read input: %s\n", errno == ENOTSUP
+            ? "compression format not supported by this build"
+            : strerror(errno));
+        return EXIT_FAILURE;
+    }
+    in = decompressed;
 
-    if (out == NULL)
-        out = stdout;
-
-    char *line = NULL;
-    size_t n;
-    unsigned int lineno = 1;
-    while (getline(&line, &n, in) != -1) {
-        utf8totex_char_t error;
-        if (utf8totex_fputs(line, fuzzy, env, out, &error) == EOF) {
-            fprintf(stderr, "failed to write line %u to output: %s\n", lineno,
-                error == UTF8TOTEX_EOF ? "resource allocation failure" :
-                error == UTF8TOTEX_INVALID ? "invalid UTF-8 character" :
-                error == UTF8TOTEX_UNSUPPORTED ? "unsupported UTF-8 character" :
-                error == UTF8TOTEX_BAD_MODIFIER ? "bad modifier character" :
-                "unknown");
-            fclose(out);
-            fclose(in);
+    /* The output is only created once nothing else can stop us writing it, so a
+     * failure does not leave an empty file behind.
+     */
+    FILE *out = stdout;
+    codec_t out_codec = CODEC_NONE;
+    if (out_path != NULL) {
+        out_codec = codec_from_name(out_path);
+        if (!codec_available(out_codec)) {
+            fprintf(stderr, "failed to write output: compression format not "
+                "supported by this build\n");
+            return EXIT_FAILURE;
+        }
+        out = fopen(out_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "failed to open %s for writing\n", out_path);
             return EXIT_FAILURE;
         }
-        lineno++;
+    }
+    /* Plain output is also written asynchronously, except into the cache
+     * where a hit is copied by the kernel straight into `out`.
+     */
+    if (out_codec != CODEC_NONE || cache_dir == NULL) {
+        FILE *compressed = codec_writer(out, out_codec);
+        if (compressed == NULL) {
+            fprintf(stderr, "failed to write output: %s\n", errno == ENOTSUP
+                ? "compression format not supported by this build"
+                : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        out = compressed;
     }
 
-    if (errno != 0) {
-        fprintf(stderr, "failed to read line from input\n");
-        fclose(out);
-        fclose(in);
-        return EXIT_FAILURE;
+    int result;
+    if (cache_dir != NULL) {
+        result = translate_cached(cache_dir, map_path, in, out, options,
+            !!_bibtex, threads);
+    } else {
+        result = translate(in, out, options, !!_bibtex, threads,
+            preamble_out == NULL ? NULL : &required);
     }
 
-    free(line);
-    fclose(out);
+    if (_stats)
+        print_stats(&stats, stderr);
+
+    if (srcmap != NULL) {
+        if (result == 0 && print_srcmap(srcmap, srcmap_out) != 0) {
+            fprintf(stderr, "failed to write source map\n");
+            result = EXIT_FAILURE;
+        }
+        utf8totex_srcmap_free(srcmap);
+        fclose(srcmap_out);
+    }
+
+    if (preamble_out != NULL) {
+        if (result == 0 &&
+            (utf8totex_fputs_preamble(required, preamble_out) != 0 ||
+             fflush(preamble_out) != 0)) {
+            fprintf(stderr, "failed to write preamble\n");
+            result = EXIT_FAILURE;
+        }
+        fclose(preamble_out);
+    }
+
+    if (translit_out != NULL) {
+        if (fclose(translit_out) != 0 && result == 0) {
+            fprintf(stderr, "failed to write transliteration\n");
+            result = EXIT_FAILURE;
+        }
+    }
+
+    utf8totex_map_free(map);
+    free(verbatim);
+    if (fclose(out) != 0 && result == EXIT_SUCCESS) {
+        fprintf(stderr, "failed to write output\n");
+        result = EXIT_FAILURE;
+    }
     fclose(in);
-    return EXIT_SUCCESS;
+    return result;
 }
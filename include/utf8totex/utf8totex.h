@@ -1,9 +1,22 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Version of this library.
+ *
+ * This changes whenever the output for any input may have changed, so it can be
+ * used to invalidate stored translations.
+ */
+#define UTF8TOTEX_VERSION "0.5.0"
+
 /**
  * @brief A TeX environment, describing font encoding and what packages are in
  *        use.
@@ -42,6 +55,122 @@ typedef struct {
  */
 #define UTF8TOTEX_DEFAULT_ENVIRONMENT ((utf8totex_environment_t){ 0 })
 
+/**
+ * @brief How aggressively to remove redundant braces from output.
+ *
+ * Sequences are stored in their fully braced form, e.g. "{\\textless}", which
+ * is always safe but not always necessary. Dropping the braces when the
+ * following character makes it unambiguous can shrink output considerably.
+ */
+typedef enum {
+    UTF8TOTEX_ELIDE_NONE = 0, /**< Always output the braced form (default) */
+    UTF8TOTEX_ELIDE_SYMBOLS,  /**< Remove braces around symbols (e.g. "{\\#}"),
+                                   but not around letters (e.g. "{\\'e}",
+                                   "{\\ss}") to keep them sorting correctly in
+                                   bibliographies */
+    UTF8TOTEX_ELIDE_ALL,      /**< Remove braces around letters as well */
+} utf8totex_elide_t;
+
+/**
+ * @brief Opaque set of user-supplied mappings that take precedence over the
+ *        built-in translation table. See `utf8totex_map_load`.
+ */
+typedef struct utf8totex_map utf8totex_map_t;
+
+/**
+ * @brief Opaque record of which input produced which output. See
+ *        `utf8totex_srcmap_new`.
+ */
+typedef struct utf8totex_srcmap utf8totex_srcmap_t;
+
+/**
+ * @brief Number of distinct unsupported code points tracked by
+ *        `utf8totex_stats_t`.
+ */
+#define UTF8TOTEX_STATS_TOP 16
+
+/**
+ * @brief Counters describing the translations that have been performed.
+ *
+ * Statistics are collected into a caller-owned instance attached to
+ * `utf8totex_options_t`. Counters are not atomic; when translating on multiple
+ * threads, give each thread its own instance and combine them afterwards with
+ * `utf8totex_stats_merge`. Zero-initialise before first use.
+ */
+typedef struct {
+    uint64_t bytes_in;    /**< UTF-8 input consumed */
+    uint64_t bytes_out;   /**< TeX output produced */
+
+    /* Code points seen, by how they were translated. */
+    uint64_t ascii;       /**< Output as-is */
+    uint64_t sequence;    /**< Escaped */
+    uint64_t modifier;    /**< Applied to the previous character */
+    uint64_t unsupported; /**< No translation available */
+    uint64_t invalid;     /**< Not valid UTF-8 or not a valid character */
+
+    /**
+     * Approximate histogram of the most frequent unsupported code points.
+     * Unused entries have a count of 0. When there are more than
+     * `UTF8TOTEX_STATS_TOP` distinct code points, counts are estimates that
+     * may overstate the true value.
+     */
+    struct {
+        uint32_t code_point;
+        uint64_t count;
+    } top_unsupported[UTF8TOTEX_STATS_TOP];
+} utf8totex_stats_t;
+
+/**
+ * @brief Options controlling a translation.
+ */
+typedef struct {
+    bool fuzzy;                    /**< Assume the input may be TeX. See
+                                        `utf8totex_from_str`. */
+    utf8totex_environment_t env;   /**< Target TeX environment */
+    utf8totex_elide_t elide_braces;/**< Brace removal in output */
+    bool coalesce_math;            /**< Output runs of consecutive math mode
+                                        sequences (e.g. Greek letters) as a
+                                        single math group */
+    size_t line_limit;             /**< Break output lines that would
+                                        otherwise exceed this many bytes, or 0
+                                        for no limit. Lines are broken at
+                                        spaces where possible, other than
+                                        before words longer than 64 bytes, and
+                                        otherwise with a '%' at the end of the
+                                        line, but never within an escape
+                                        sequence or, in fuzzy mode, TeX
+                                        input; a line may
+                                        still exceed the limit where there is
+                                        nowhere to break it. This keeps long
+                                        paragraphs within TeX's input buffer
+                                        size. */
+    const utf8totex_map_t *map;    /**< Optional overlay consulted before the
+                                        built-in table */
+    utf8totex_stats_t *stats;      /**< Optional statistics to update */
+    utf8totex_srcmap_t *srcmap;    /**< Optional source map to extend */
+    FILE *translit;                /**< Optional stream to write a plain ASCII
+                                        transliteration of the input to, as
+                                        given by `utf8totex_seq_t.ascii`. In
+                                        fuzzy mode, TeX in the input is
+                                        reduced to its text. This is produced
+                                        in the same pass as the translation. */
+    const char *const *verbatim;   /**< In fuzzy mode, a `NULL`-terminated
+                                        list of macros, such as "\\url",
+                                        whose argument and environments, such
+                                        as "verbatim", whose body is passed
+                                        through untouched, even where it is
+                                        not ASCII. An argument is either
+                                        braced or delimited as for \\verb.
+                                        `NULL` means \\href, \\path, \\url,
+                                        \\verb, comment, lstlisting, minted,
+                                        Verbatim, verbatim and verbatim*. */
+} utf8totex_options_t;
+
+/**
+ * @brief The default translation options.
+ */
+#define UTF8TOTEX_DEFAULT_OPTIONS ((utf8totex_options_t){ 0 })
+
 /**
  * @brief Return type of `utf8totex_from_char` indicating what kind of data the given
  *        character was.
@@ -102,8 +231,9 @@ typedef enum {
  * @param s Input string.
  * @param fuzzy Whether to assume the input may be TeX. If this parameter is
  *              true, we assume the input string may be valid TeX and try to
- *              avoid translating things that look like macros, braced
- *              expressions or math mode expressions.
+ *              avoid translating things that look like macros, translating
+ *              only text, including that in the arguments of macros. Text
+ *              in math mode is translated to math mode macros.
  * @param env Target TeX environment.
  * @param error Optional output pointer for the error value if there was one.
  * @return Output string or `NULL` if the operation failed. The caller should
@@ -120,8 +250,9 @@ char *utf8totex_from_str(const char *s, bool fuzzy,
  * @param s Input string.
  * @param fuzzy Whether to assume the input may be TeX. If this parameter is
  *              true, we assume the input string may be valid TeX and try to
- *              avoid translating things that look like macros, braced
- *              expressions or math mode expressions.
+ *              avoid translating things that look like macros, translating
+ *              only text, including that in the arguments of macros. Text
+ *              in math mode is translated to math mode macros.
  * @param env Target TeX environment.
  * @param f File to write to.
  * @param error Optional output pointer for the error value if there was one.
@@ -130,6 +261,554 @@ char *utf8totex_from_str(const char *s, bool fuzzy,
 int utf8totex_fputs(const char *s, bool fuzzy, utf8totex_environment_t env,
     FILE *f, utf8totex_char_t *error) __attribute__((nonnull(1, 4)));
 
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string with the given
+ *        options.
+ *
+ * @param s Input string.
+ * @param options Translation options.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return Output string or `NULL` if the operation failed. The caller should
+ *         eventually free this pointer.
+ */
+char *utf8totex_from_str_opt(const char *s, utf8totex_options_t options,
+    utf8totex_char_t *error) __attribute__((nonnull(1)));
+
+/**
+ * @brief Memory allocation callbacks.
+ *
+ * Each callback receives `user` as its first argument. `realloc` and `free`
+ * are also given the size the block was allocated with.
+ */
+typedef struct {
+    void *(*alloc)(void *user, size_t size);
+    void *(*realloc)(void *user, void *p, size_t old_size, size_t new_size);
+    void (*free)(void *user, void *p, size_t size);
+    void *user;
+} utf8totex_allocator_t;
+
+/**
+ * @brief A bump allocator over caller-supplied memory.
+ *
+ * Allocations are carved off the front of `base` in turn and are never
+ * individually released. Setting `used` back to `0` releases everything at
+ * once.
+ */
+typedef struct {
+    char *base;  /**< Start of the memory to allocate from */
+    size_t size; /**< Size of `base` */
+    size_t used; /**< Bytes of `base` allocated so far */
+} utf8totex_arena_t;
+
+/**
+ * @brief Get an allocator that allocates from the given arena.
+ *
+ * @param arena Arena to allocate from. This must outlive the allocator.
+ * @return The allocator.
+ */
+utf8totex_allocator_t utf8totex_arena_allocator(utf8totex_arena_t *arena)
+    __attribute__((nonnull));
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string with the given
+ *        options, allocating the result with the given allocator.
+ *
+ * @param s Input string.
+ * @param options Translation options.
+ * @param allocator Allocator to obtain the result from.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return Output string or `NULL` if the operation failed. On success, the
+ *         caller should eventually release this pointer through `allocator`,
+ *         with a size of its length plus one.
+ */
+char *utf8totex_from_str_alloc(const char *s, utf8totex_options_t options,
+    const utf8totex_allocator_t *allocator, utf8totex_char_t *error)
+    __attribute__((nonnull(1, 3)));
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string with the given
+ *        options, allocating the result from the given arena.
+ *
+ * @param s Input string.
+ * @param options Translation options.
+ * @param arena Arena to allocate the result from.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return Output string or `NULL` if the operation failed, including if the
+ *         arena has insufficient space. On failure, the arena is unchanged.
+ */
+char *utf8totex_from_str_arena(const char *s, utf8totex_options_t options,
+    utf8totex_arena_t *arena, utf8totex_char_t *error)
+    __attribute__((nonnull(1, 3)));
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string with the given
+ *        options and write the result to the given file.
+ *
+ * @param s Input string.
+ * @param options Translation options.
+ * @param f File to write to.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success.
+ */
+int utf8totex_fputs_opt(const char *s, utf8totex_options_t options, FILE *f,
+    utf8totex_char_t *error) __attribute__((nonnull(1, 3)));
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string using multiple
+ *        threads and write the result to the given file.
+ *
+ * The input is split into chunks at spaces and newlines (in fuzzy mode, only
+ * those outside TeX constructs) which are translated concurrently. Output is
+ * identical to that of `utf8totex_fputs_opt`. This is only worthwhile for very
+ * large strings; small inputs are translated on the calling thread.
+ *
+ * With a `line_limit`, a chunk cannot know where its lines break until the one
+ * before it is done, so each chunk is translated as if it started a line and
+ * then translated again on the calling thread from the right column until the
+ * two agree. They always agree after a newline in the input, but can take a
+ * long time to otherwise, so input with few newlines gains less.
+ *
+ * @param s Input string.
+ * @param options Translation options.
+ * @param threads Maximum number of threads to use, or `0` to use one per
+ *                online CPU.
+ * @param f File to write to.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success.
+ */
+int utf8totex_fputs_parallel(const char *s, utf8totex_options_t options,
+    unsigned threads, FILE *f, utf8totex_char_t *error)
+    __attribute__((nonnull(1, 4)));
+
+/**
+ * @brief One of the environments translated for by `utf8totex_fputs_multi`.
+ */
+typedef struct {
+    utf8totex_environment_t env; /**< Target TeX environment */
+    FILE *f;                     /**< File to write the translation to */
+    utf8totex_stats_t *stats;    /**< Optional statistics in which to record
+                                      characters unsupported in `env`. Only
+                                      the `unsupported` and `top_unsupported`
+                                      counters are updated, and these continue
+                                      to be updated after the translation for
+                                      this environment has failed. */
+    int result;                  /**< Set to `0` if the translation for this
+                                      environment succeeded, `EOF` otherwise */
+    utf8totex_char_t error;      /**< Set to the error, if there was one */
+} utf8totex_target_t;
+
+/**
+ * @brief Translate a UTF-8 string to ASCII TeX strings for several
+ *        environments at once.
+ *
+ * The input is translated in a single pass, regardless of the number of
+ * environments. The output for each environment is identical to that of
+ * `utf8totex_fputs_opt` with `options.env` set to it, including when
+ * translation fails partway; the translation for an environment stops at the
+ * first character that environment does not support while the others
+ * continue.
+ *
+ * @param s Input string.
+ * @param options Translation options. `options.env` is ignored, and any
+ *                statistics or source map describe the translation for
+ *                environments that succeed.
+ * @param targets Environments to translate for.
+ * @param n Number of entries in `targets`.
+ * @return `0` if the translations for all environments succeeded, `EOF`
+ *         otherwise.
+ */
+int utf8totex_fputs_multi(const char *s, utf8totex_options_t options,
+    utf8totex_target_t *targets, size_t n) __attribute__((nonnull(1)));
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string for the least
+ *        demanding environment able to represent it.
+ *
+ * Every character is translated as it would be in `options.env`, but
+ * `required` is updated to record which parts of that environment the output
+ * actually depends on. Starting from `UTF8TOTEX_DEFAULT_ENVIRONMENT`, the
+ * result is OT1 without textcomp unless the input needed more. A document
+ * translated in pieces can pass the same `required` to each call to find what
+ * the whole document needs.
+ *
+ * @param s Input string.
+ * @param options Translation options. `options.env` gives the most capable
+ *                environment that may be required.
+ * @param f File to write to.
+ * @param required Environment to extend with the requirements of the output.
+ *                 This is updated even if translation fails, to cover the
+ *                 output that was written.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success.
+ */
+int utf8totex_fputs_auto(const char *s, utf8totex_options_t options, FILE *f,
+    utf8totex_environment_t *required, utf8totex_char_t *error)
+    __attribute__((nonnull(1, 3, 4)));
+
+/**
+ * @brief Write the LaTeX preamble lines that set up an environment.
+ *
+ * For example, T1 with textcomp gives "\usepackage[T1]{fontenc}" and
+ * "\usepackage{textcomp}" on separate lines. Nothing is written for the
+ * default environment.
+ *
+ * @param env Environment to describe.
+ * @param f File to write to.
+ * @return `0` on success or `EOF` on an output error.
+ */
+int utf8totex_fputs_preamble(utf8totex_environment_t env, FILE *f)
+    __attribute__((nonnull));
+
+/**
+ * @brief Add the counters from one statistics instance into another.
+ *
+ * @param into Statistics to update.
+ * @param from Statistics to add.
+ */
+void utf8totex_stats_merge(utf8totex_stats_t *into,
+    const utf8totex_stats_t *from) __attribute__((nonnull));
+
+/* Source maps.
+ *
+ * For attributing errors TeX reports against the output back to the input that
+ * caused them. A source map attached to `utf8totex_options_t` is extended by
+ * each translation using it, so a document translated in pieces through
+ * successive calls gets a single map with offsets relative to the start of the
+ * whole document. Source maps are not supported by the incremental interface,
+ * and translating in parallel with one falls back to a single thread.
+ */
+
+/**
+ * @brief Corresponding ranges of input and output.
+ *
+ * Within an entry that is an identity run, byte `i` of the input produced byte
+ * `i` of the output. Otherwise the entry is a single escape and the whole input
+ * range produced the whole output range.
+ */
+typedef struct {
+    size_t in;        /**< Byte offset of the start of the input range */
+    size_t out;       /**< Byte offset of the start of the output range */
+    uint32_t in_len;  /**< Length of the input range */
+    uint32_t out_len; /**< Length of the output range */
+    bool identity;    /**< Whether this is a run of unchanged ASCII */
+} utf8totex_srcmap_entry_t;
+
+/**
+ * @brief Create a new, empty source map.
+ *
+ * @return A new source map or `NULL` on out-of-memory. The caller should
+ *         eventually release this with `utf8totex_srcmap_free`.
+ */
+utf8totex_srcmap_t *utf8totex_srcmap_new(void);
+
+/**
+ * @brief Get the entries of a source map.
+ *
+ * Entries are ordered and together cover both the input and output without
+ * gaps.
+ *
+ * @param m Source map to query.
+ * @param len Output pointer for the number of entries.
+ * @return The entries, valid until the map is next extended.
+ */
+const utf8totex_srcmap_entry_t *utf8totex_srcmap_entries(
+    const utf8totex_srcmap_t *m, size_t *len) __attribute__((nonnull));
+
+/**
+ * @brief Find the output produced by a given byte of input.
+ *
+ * @param m Source map to query.
+ * @param offset Byte offset in the input.
+ * @param range Output pointer for the smallest ranges containing `offset`
+ *              that correspond to each other.
+ * @return `0` on success or `-1` if `offset` is beyond the mapped input.
+ */
+int utf8totex_srcmap_to_output(const utf8totex_srcmap_t *m, size_t offset,
+    utf8totex_srcmap_entry_t *range) __attribute__((nonnull));
+
+/**
+ * @brief Find the input that produced a given byte of output.
+ *
+ * @param m Source map to query.
+ * @param offset Byte offset in the output.
+ * @param range Output pointer for the smallest ranges containing `offset`
+ *              that correspond to each other.
+ * @return `0` on success or `-1` if `offset` is beyond the mapped output.
+ */
+int utf8totex_srcmap_to_input(const utf8totex_srcmap_t *m, size_t offset,
+    utf8totex_srcmap_entry_t *range) __attribute__((nonnull));
+
+/**
+ * @brief Release a source map.
+ *
+ * @param m Source map to release. May be `NULL`.
+ */
+void utf8totex_srcmap_free(utf8totex_srcmap_t *m);
+
+/* Incremental interface.
+ *
+ * For callers such as editors that repeatedly re-translate a large document
+ * after small changes. A document retains its input and output, and after an
+ * edit only re-translates the region around it.
+ */
+
+/**
+ * @brief Opaque state of a document being incrementally translated.
+ */
+typedef struct utf8totex_document utf8totex_document_t;
+
+/**
+ * @brief A change to a document's output.
+ */
+typedef struct {
+    size_t offset;        /**< Start of the changed range in the previous
+                               output */
+    size_t removed;       /**< Number of bytes of previous output replaced */
+    const char *inserted; /**< Replacement text, valid until the next edit */
+    size_t inserted_len;  /**< Length of `inserted` */
+} utf8totex_patch_t;
+
+/**
+ * @brief Create a document and translate its initial content.
+ *
+ * @param s Initial input.
+ * @param options Translation options. Any map or statistics referenced must
+ *                outlive the document. Any transliteration stream is
+ *                ignored.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return A new document or `NULL` on failure. The caller should eventually
+ *         release this with `utf8totex_document_free`.
+ */
+utf8totex_document_t *utf8totex_document_new(const char *s,
+    utf8totex_options_t options, utf8totex_char_t *error)
+    __attribute__((nonnull(1)));
+
+/**
+ * @brief Get the current translated output of a document.
+ *
+ * @param d Document to query.
+ * @param len Optional output pointer for the length of the output.
+ * @return The output as a NUL-terminated string, valid until the next edit.
+ */
+const char *utf8totex_document_output(const utf8totex_document_t *d,
+    size_t *len) __attribute__((nonnull(1)));
+
+/**
+ * @brief Change a document's input and update its output.
+ *
+ * @param d Document to change.
+ * @param offset Byte offset in the input at which to make the change.
+ * @param removed Number of bytes of input to remove at `offset`.
+ * @param inserted Text to insert at `offset`.
+ * @param patch Optional output pointer describing the resulting change to the
+ *              output.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success. On failure, the document is unchanged.
+ */
+int utf8totex_document_edit(utf8totex_document_t *d, size_t offset,
+    size_t removed, const char *inserted, utf8totex_patch_t *patch,
+    utf8totex_char_t *error) __attribute__((nonnull(1, 4)));
+
+/**
+ * @brief Release a document.
+ *
+ * @param d Document to release. May be `NULL`.
+ */
+void utf8totex_document_free(utf8totex_document_t *d);
+
+/* Mapping overlays.
+ *
+ * For overriding the built-in translation of particular characters or adding
+ * translations for characters that are otherwise unsupported.
+ */
+
+/**
+ * @brief Load a mapping overlay from a file.
+ *
+ * Each non-blank line of the file that does not start with '#' contains a code
+ * point, either as "U+XXXX" or a literal UTF-8 character, then whitespace and
+ * the ASCII TeX sequence it should be translated to. Code points that cannot
+ * occur in valid UTF-8, surrogates and those beyond U+10FFFF, are syntax
+ * errors. A loaded map is read-only, so it can be loaded once and shared
+ * between threads.
+ *
+ * @param path File to read.
+ * @param error_line Optional output pointer for the line number of a syntax
+ *                   error, if there was one.
+ * @return A new map or `NULL` on failure, with `errno` set. The caller should
+ *         eventually release this with `utf8totex_map_free`.
+ */
+utf8totex_map_t *utf8totex_map_load(const char *path, unsigned *error_line)
+    __attribute__((nonnull(1)));
+
+/**
+ * @brief Release a mapping overlay.
+ *
+ * @param map Map to release. May be `NULL`.
+ */
+void utf8totex_map_free(utf8totex_map_t *map);
+
+/* BibTeX interface.
+ *
+ * For translating .bib databases, where only the values of fields should be
+ * translated and everything else (entry types, citation keys, field names,
+ * `@string` macros, comments) must be left untouched. Input is streamed through
+ * a scanner that retains its state between calls, so a database can be fed in
+ * pieces of any size.
+ */
+
+/**
+ * @brief Opaque state of a streaming BibTeX scanner.
+ */
+typedef struct utf8totex_bibtex utf8totex_bibtex_t;
+
+/**
+ * @brief Create a new BibTeX scanner.
+ *
+ * @param env Target TeX environment for translated field values.
+ * @return A new scanner or `NULL` on allocation failure. The caller should
+ *         eventually release this with `utf8totex_bibtex_free`.
+ */
+utf8totex_bibtex_t *utf8totex_bibtex_new(utf8totex_environment_t env);
+
+/**
+ * @brief Create a new BibTeX scanner with more control over how field values
+ *        are translated.
+ *
+ * Values are always translated in fuzzy mode. Each value is translated on its
+ * own, so `line_limit`, `srcmap` and `translit` are ignored, and `stats` only
+ * counts the contents of values.
+ *
+ * @param options Options for translating field values.
+ * @return A new scanner or `NULL` on allocation failure. The caller should
+ *         eventually release this with `utf8totex_bibtex_free`.
+ */
+utf8totex_bibtex_t *utf8totex_bibtex_new_opt(utf8totex_options_t options);
+
+/**
+ * @brief Feed the next piece of a BibTeX database through a scanner and write
+ *        the result to the given file.
+ *
+ * Field values are translated as if by `utf8totex_fputs_opt` with the
+ * scanner's options.
+ * Values spanning multiple calls are buffered and written once complete.
+ *
+ * @param b Scanner to use.
+ * @param s Next piece of input.
+ * @param f File to write to.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success.
+ */
+int utf8totex_bibtex_fputs(utf8totex_bibtex_t *b, const char *s, FILE *f,
+    utf8totex_char_t *error) __attribute__((nonnull(1, 2, 3)));
+
+/**
+ * @brief Indicate the end of input to a BibTeX scanner.
+ *
+ * @param b Scanner to use.
+ * @param f File to write any remaining output to.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success or `EOF` if the input ended in the middle of a value.
+ */
+int utf8totex_bibtex_finish(utf8totex_bibtex_t *b, FILE *f,
+    utf8totex_char_t *error) __attribute__((nonnull(1, 2)));
+
+/**
+ * @brief Release a BibTeX scanner.
+ *
+ * @param b Scanner to release. May be `NULL`.
+ */
+void utf8totex_bibtex_free(utf8totex_bibtex_t *b);
+
+/* Translation stores.
+ *
+ * For translating a large, slowly changing set of records once for every
+ * environment it is needed in and then looking up the results many times. A
+ * store is a single file that is mapped into memory, so lookups return
+ * translations in place without copying or parsing anything.
+ */
+
+/**
+ * @brief Opaque handle to an open translation store.
+ */
+typedef struct utf8totex_store utf8totex_store_t;
+
+/**
+ * @brief Create or update a translation store from a stream of records.
+ *
+ * Each non-empty line of `records` is a key, a tab and then the UTF-8 text of
+ * that record, which replaces any existing record with the same key. A line
+ * with no tab deletes the record with that key. Records in an existing store
+ * that are not mentioned are kept. A record whose text is unchanged reuses its
+ * existing translations, unless the store was written by a different version
+ * of the library, with different options or for different environments, in
+ * which case every record is translated again.
+ *
+ * The store is written to a temporary file and renamed into place, so stores
+ * already open carry on seeing the old content.
+ *
+ * @param path Store to create or update.
+ * @param records Records to add, replace or delete.
+ * @param options Translation options. Only `fuzzy`, `elide_braces`,
+ *                `coalesce_math` and `line_limit` are used, with fuzzy mode
+ *                using the default `verbatim` list.
+ * @param envs Environments to translate every record for.
+ * @param n Number of entries in `envs`.
+ * @return `0` on success or `-1` with `errno` set on failure, in which case
+ *         the store is left unchanged. A record that cannot be translated for
+ *         an environment is not a failure; see `utf8totex_store_lookup`.
+ */
+int utf8totex_store_update(const char *path, FILE *records,
+    utf8totex_options_t options, const utf8totex_environment_t *envs,
+    size_t n) __attribute__((nonnull(1, 2)));
+
+/**
+ * @brief Open a translation store for lookups.
+ *
+ * An open store is read-only, so it can be opened once and shared between
+ * threads.
+ *
+ * @param path Store to open.
+ * @return A store or `NULL` on failure, with `errno` set. This is `ESTALE`
+ *         if the store was written by a different version of the library and
+ *         needs updating, or `EINVAL` if it is not a valid store. The caller
+ *         should eventually release this with `utf8totex_store_free`.
+ */
+utf8totex_store_t *utf8totex_store_open(const char *path)
+    __attribute__((nonnull(1)));
+
+/**
+ * @brief Look up the translation of a record.
+ *
+ * @param s Store to look in.
+ * @param key Key of the record.
+ * @param env Environment to get the translation for.
+ * @param len Optional output pointer for the length of the translation.
+ * @param error Optional output pointer for the error translating the record
+ *              for this environment, if there was one.
+ * @return The NUL-terminated translation, valid until the store is released,
+ *         or `NULL` with `errno` set to `ENOENT` if the store has no record
+ *         with this key or was not built for this environment, or `EILSEQ` if
+ *         the record could not be translated for it.
+ */
+const char *utf8totex_store_lookup(const utf8totex_store_t *s,
+    const char *key, utf8totex_environment_t env, size_t *len,
+    utf8totex_char_t *error) __attribute__((nonnull(1, 2)));
+
+/**
+ * @brief Release a translation store.
+ *
+ * @param s Store to release. May be `NULL`.
+ */
+void utf8totex_store_free(utf8totex_store_t *s);
+
+/**
+ * @brief Get the version of the library in use.
+ *
+ * @return `UTF8TOTEX_VERSION` as it was when the library was built.
+ */
+const char *utf8totex_version(void);
+
 /* Low level interface.
  *
  * It is unlikely you will need this unless you need to move
@@ -153,3 +832,70 @@ int utf8totex_fputs(const char *s, bool fuzzy, utf8totex_environment_t env,
  */
 utf8totex_char_t utf8totex_from_char(const char **s, uint32_t c,
     utf8totex_environment_t env) __attribute__((nonnull));
+
+/**
+ * @brief Flags describing a TeX escape sequence. See `utf8totex_seq_t`.
+ */
+enum {
+    UTF8TOTEX_SEQ_MATH = 1 << 0,
+        /**< The sequence is a single math mode group, "$...$". */
+    UTF8TOTEX_SEQ_DOTLESS = 1 << 1,
+        /**< The sequence is a modifier whose accent should be applied to a
+             dotless "\i" or "\j" rather than "i" or "j". */
+    UTF8TOTEX_SEQ_CONTROL_WORD = 1 << 2,
+        /**< The sequence, or its body if it is a math mode group, ends in a
+             control word such that a following letter would become part of
+             its name. */
+    UTF8TOTEX_SEQ_CYRILLIC = 1 << 3,
+        /**< The sequence is a single Cyrillic letter, "{\CYR...}" or
+             "{\cyr...}", whose braces can be shared with adjacent such
+             letters. */
+};
+
+/**
+ * @brief A TeX escape sequence with its properties.
+ */
+typedef struct {
+    const char *str;   /**< NUL-terminated sequence */
+    size_t len;        /**< Length of `str` */
+    unsigned flags;    /**< Bitwise OR of `UTF8TOTEX_SEQ_*` values */
+    const char *ascii; /**< NUL-terminated plain ASCII transliteration of the
+                            character, e.g. "e" for "é", "ss" for "ß" or
+                            "alpha" for "α", suitable for sorting. This is
+                            empty for modifiers and for symbols with no
+                            sensible transliteration. */
+    size_t ascii_len;  /**< Length of `ascii` */
+} utf8totex_seq_t;
+
+/**
+ * @brief Translate a single UTF-8 character into TeX output, along with the
+ *        length and properties of the output.
+ *
+ * As for `utf8totex_from_char`, but with all information about a returned
+ * sequence precomputed so callers need not inspect its text.
+ *
+ * @param seq An output pointer to write the TeX escape sequence into when the
+ *            return value is `UTF8TOTEX_SEQUENCE` or `UTF8TOTEX_MODIFIER`.
+ *            `seq->str` will point at a static constant string.
+ * @param c The input UTF-8 character.
+ * @param env Target TeX environment.
+ * @return See the definition of `utf8totex_char_t` for how to interpret this value.
+ */
+utf8totex_char_t utf8totex_from_char_ex(utf8totex_seq_t *seq, uint32_t c,
+    utf8totex_environment_t env) __attribute__((nonnull));
+
+/**
+ * @brief Look up a single character in a mapping overlay.
+ *
+ * @param map Map to look in.
+ * @param c The input UTF-8 character.
+ * @param seq An output pointer to write the TeX escape sequence for `c` into,
+ *            if the map has one. `seq->str` will point into the map.
+ * @return `true` if the map has a sequence for `c`.
+ */
+bool utf8totex_map_lookup(const utf8totex_map_t *map, uint32_t c,
+    utf8totex_seq_t *seq) __attribute__((nonnull));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1030 @@
+#pragma once
+
+/* C++ interface.
+ *
+ * A header-only translation loop over `std::string_view` input writing to a
+ * sink given as a template parameter, so that appending output compiles down to
+ * inline code with no `FILE*` or other indirect calls. Characters are looked up
+ * in the same table as the C interface, through `utf8totex_from_char_ex`, and
+ * the output is identical to that of `utf8totex_fputs_opt`.
+ *
+ * With C++20, string literals can also be translated entirely at compile time
+ * by `translate_literal`, which evaluates the table in table.inc directly.
+ */
+
+#if __cplusplus < 201703L
+#error "utf8totex.hpp requires C++17"
+#endif
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "utf8totex/utf8totex.h"
+
+namespace utf8totex {
+
+namespace detail {
+
+/* A sink with an `append(const char*, size_t)` member, as `std::string` and
+ * `std::pmr::string` have. Anything else is treated as an output iterator.
+ */
+template <typename T, typename = void>
+struct is_appender : std::false_type {};
+
+template <typename T>
+struct is_appender<T, std::void_t<decltype(std::declval<T&>().append(
+    std::declval<const char*>(), std::size_t{}))>> : std::true_type {};
+
+template <typename Sink>
+constexpr void put(Sink &sink, const char *p, std::size_t n) {
+    if constexpr (is_appender<Sink>::value) {
+        sink.append(p, n);
+    } else {
+        for (std::size_t i = 0; i < n; i++) {
+            *sink = p[i];
+            ++sink;
+        }
+    }
+}
+
+/* The rest of this namespace mirrors fputs.c and get_utf8_char.c. */
+
+constexpr bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+constexpr bool merges_with_control_word(char next) {
+    return next == '\0' || is_letter(next) || is_space(next);
+}
+
+constexpr bool is_accent_symbol(char c) {
+    return c == '"' || c == '\'' || c == '.' || c == '=' || c == '^' ||
+           c == '`' || c == '~';
+}
+
+constexpr bool is_letter_word(std::string_view name) {
+    for (std::string_view letter : { "AA", "aa", "AE", "ae", "DH", "dh", "DJ",
+            "dj", "i", "j", "L", "l", "NG", "ng", "O", "o", "OE", "oe", "SS",
+            "ss", "TH", "th" }) {
+        if (letter == name)
+            return true;
+    }
+    return false;
+}
+
+constexpr bool can_elide(const char *t, std::size_t len, char next,
+        utf8totex_elide_t mode) {
+
+    if (len < 4 || t[0] != '{' || t[1] != '\\' || t[len - 1] != '}')
+        return false;
+
+    const char *inner = t + 2;
+    std::size_t inner_len = len - 3;
+
+    if (inner_len == 1 && !is_letter(inner[0]))
+        return !is_accent_symbol(inner[0]);
+
+    std::size_t word = 0;
+    while (word < inner_len && is_letter(inner[word]))
+        word++;
+    if (word == inner_len) {
+        if (mode != UTF8TOTEX_ELIDE_ALL &&
+            is_letter_word(std::string_view(inner, inner_len)))
+            return false;
+        return !merges_with_control_word(next);
+    }
+
+    if (mode != UTF8TOTEX_ELIDE_ALL)
+        return false;
+
+    std::size_t arg = 0;
+    if (word == 0 && is_accent_symbol(inner[0])) {
+        arg = 1;
+    } else if (word == 1 && inner[1] == ' ') {
+        arg = 2;
+    } else {
+        return false;
+    }
+    if (inner_len == arg + 1 && is_letter(inner[arg]))
+        return next != '\0' && !is_letter(next);
+    if (inner_len == arg + 2 && inner[arg] == '\\' &&
+        (inner[arg + 1] == 'i' || inner[arg + 1] == 'j'))
+        return !merges_with_control_word(next);
+    return false;
+}
+
+/* The longest word looked ahead for when breaking lines, as in fputs.c. */
+constexpr std::size_t long_word = 64;
+
+constexpr std::size_t word_length(const char *s, const char *end,
+        std::size_t max) {
+    std::size_t n = 0;
+    while (n < max && s + n != end && s[n] != '\0' && !is_space(s[n]))
+        n++;
+    return n;
+}
+
+/* Decode the character at `s`, returning its length, 0 at the end of the
+ * input or -1 if it is invalid.
+ */
+constexpr int get_utf8_char(std::uint32_t &c, const char *s, const char *end) {
+    if (s == end || *s == '\0')
+        return 0;
+
+    const auto leader = static_cast<unsigned char>(*s);
+    int len = 0;
+    if (leader < 0x80) {
+        c = leader;
+        return 1;
+    } else if ((leader & 0xe0) == 0xc0) {
+        len = 2;
+        c = leader & 0x1f;
+    } else if ((leader & 0xf0) == 0xe0) {
+        len = 3;
+        c = leader & 0x0f;
+    } else if ((leader & 0xf8) == 0xf0) {
+        len = 4;
+        c = leader & 0x07;
+    } else {
+        return -1;
+    }
+
+    for (int i = 1; i < len; i++) {
+        if (s + i == end)
+            return -1;
+        const auto byte = static_cast<unsigned char>(s[i]);
+        if ((byte & 0xc0) != 0x80)
+            return -1;
+        c = (c << 6) | (byte & 0x3f);
+    }
+    return len;
+}
+
+constexpr int fail(utf8totex_char_t *error, utf8totex_char_t code) {
+    if (error != nullptr)
+        *error = code;
+    return EOF;
+}
+
+/* The fuzzy mode state machine, mirroring fuzzy.c. */
+
+inline constexpr std::string_view default_verbatim[] = { "\\href", "\\path",
+    "\\url", "\\verb", "comment", "lstlisting", "minted", "Verbatim",
+    "verbatim", "verbatim*" };
+
+enum fuzzy_state : unsigned {
+    fuzzy_idle,
+    fuzzy_macro,
+    fuzzy_braced,
+    fuzzy_math,
+    fuzzy_args,
+    fuzzy_begin,
+    fuzzy_env_name,
+    fuzzy_verb_open,
+    fuzzy_verbatim,
+    fuzzy_verb_env,
+    fuzzy_math_open,
+    fuzzy_math_macro,
+    fuzzy_math_close,
+};
+
+enum class fuzzy_action {
+    text, word_text, tex, literal, hidden, bad, math_text, math_word_text
+};
+
+struct fuzzy_machine {
+    const char *const *verbatim = nullptr;
+    unsigned state = fuzzy_idle;
+    unsigned brace_depth = 0;
+    unsigned brackets = 0;
+    char name[32] = {0};
+    std::size_t name_len = 0;
+    char delimiter = 0;
+    std::size_t progress = 0;
+
+    constexpr unsigned context() const {
+        return brace_depth > 0 || brackets > 0 ? fuzzy_braced : fuzzy_idle;
+    }
+
+    constexpr void name_append(char c) {
+        if (name_len < sizeof(name) - 1)
+            name[name_len] = c;
+        if (name_len < sizeof(name))
+            name_len++;
+    }
+
+    constexpr bool name_is(std::string_view n) const {
+        return name_len == n.size() && std::string_view(name, name_len) == n;
+    }
+
+    constexpr bool is_verbatim(bool macro) const {
+        auto matches = [&](std::string_view v) {
+            return !v.empty() && (v[0] == '\\') == macro &&
+                   name_is(v.substr(macro));
+        };
+        if (verbatim == nullptr) {
+            for (std::string_view v : default_verbatim) {
+                if (matches(v))
+                    return true;
+            }
+            return false;
+        }
+        for (const char *const *v = verbatim; *v != nullptr; v++) {
+            if (matches(*v))
+                return true;
+        }
+        return false;
+    }
+
+    constexpr fuzzy_action math(char d, std::size_t p) {
+        delimiter = d;
+        progress = p;
+        state = fuzzy_math;
+        return fuzzy_action::tex;
+    }
+
+    constexpr char end_char(std::size_t i) const {
+        return i < 5 ? "\\end{"[i] : i < 5 + name_len ? name[i - 5] : '}';
+    }
+
+    constexpr fuzzy_action step(char c) {
+        const bool ascii = static_cast<unsigned char>(c) < 0x80;
+
+        switch (state) {
+
+            case fuzzy_idle:
+                if (c == '\\') {
+                    name_len = 0;
+                    state = fuzzy_macro;
+                } else if (c == '{') {
+                    brace_depth = 1;
+                    state = fuzzy_braced;
+                } else if (c == '$') {
+                    state = fuzzy_math_open;
+                } else {
+                    return fuzzy_action::text;
+                }
+                return fuzzy_action::tex;
+
+            case fuzzy_braced:
+                if (!ascii)
+                    return fuzzy_action::text;
+                if (c == '\\') {
+                    name_len = 0;
+                    state = fuzzy_macro;
+                } else if (c == '{') {
+                    brace_depth++;
+                } else if (c == '$') {
+                    state = fuzzy_math_open;
+                } else if (c == '}' && brace_depth > 0) {
+                    brace_depth--;
+                    state = context();
+                } else if (c == ']' && brackets > 0) {
+                    brackets--;
+                    state = context();
+                }
+                return fuzzy_action::tex;
+
+            case fuzzy_math_open:
+                if (c == '$')
+                    return math('$', 2);
+                math('$', 1);
+                return step(c);
+
+            case fuzzy_math:
+                if (!ascii)
+                    return fuzzy_action::math_text;
+                if (c == '\\') {
+                    name_len = 0;
+                    state = fuzzy_math_macro;
+                } else if (c == '$' && delimiter == '$') {
+                    state = progress == 1 ? context() : fuzzy_math_close;
+                }
+                return fuzzy_action::tex;
+
+            case fuzzy_math_close:
+                state = context();
+                if (c == '$')
+                    return fuzzy_action::tex;
+                return step(c);
+
+            case fuzzy_math_macro: {
+                if (is_letter(c)) {
+                    name_len = 1;
+                    return fuzzy_action::tex;
+                }
+                if (name_len == 0) {
+                    if (!ascii)
+                        return fuzzy_action::bad;
+                    state = c == delimiter && c != '$' ? context() : fuzzy_math;
+                    return fuzzy_action::tex;
+                }
+                state = fuzzy_math;
+                const fuzzy_action action = step(c);
+                return action == fuzzy_action::math_text
+                         ? fuzzy_action::math_word_text : action;
+            }
+
+            case fuzzy_macro:
+                if (is_letter(c)) {
+                    name_append(c);
+                    return fuzzy_action::tex;
+                }
+                if (name_len == 0) {
+                    if (!ascii)
+                        return fuzzy_action::bad;
+                    if (c == '(')
+                        return math(')', 1);
+                    if (c == '[')
+                        return math(']', 1);
+                    state = fuzzy_args;
+                    return fuzzy_action::tex;
+                }
+                if (is_verbatim(true)) {
+                    state = fuzzy_verb_open;
+                } else if (name_is("begin")) {
+                    state = fuzzy_begin;
+                } else {
+                    state = fuzzy_args;
+                    const fuzzy_action action = step(c);
+                    return action == fuzzy_action::text
+                             ? fuzzy_action::word_text : action;
+                }
+                return step(c);
+
+            case fuzzy_args:
+                if (is_space(c) || c == '*')
+                    return fuzzy_action::tex;
+                if (c == '[') {
+                    brackets++;
+                    state = fuzzy_braced;
+                    return fuzzy_action::tex;
+                }
+                state = context();
+                return step(c);
+
+            case fuzzy_begin:
+                if (is_space(c))
+                    return fuzzy_action::tex;
+                if (c == '{') {
+                    name_len = 0;
+                    state = fuzzy_env_name;
+                    return fuzzy_action::tex;
+                }
+                state = context();
+                return step(c);
+
+            case fuzzy_env_name:
+                if (!ascii)
+                    return fuzzy_action::bad;
+                if (c == '}') {
+                    if (is_verbatim(false)) {
+                        progress = 0;
+                        state = fuzzy_verb_env;
+                    } else {
+                        state = context();
+                    }
+                } else {
+                    name_append(c);
+                }
+                return fuzzy_action::tex;
+
+            case fuzzy_verb_open:
+                if (!ascii)
+                    return fuzzy_action::bad;
+                if (is_space(c) || c == '*')
+                    return fuzzy_action::hidden;
+                delimiter = c == '{' ? '}' : c;
+                progress = 1;
+                state = fuzzy_verbatim;
+                return fuzzy_action::hidden;
+
+            case fuzzy_verbatim:
+                if (delimiter == '}' && c == '{') {
+                    progress++;
+                } else if (c == delimiter && --progress == 0) {
+                    state = context();
+                    return fuzzy_action::hidden;
+                }
+                return fuzzy_action::literal;
+
+            case fuzzy_verb_env:
+                if (c == end_char(progress)) {
+                    if (++progress == name_len + 6)
+                        state = context();
+                } else {
+                    progress = c == '\\';
+                }
+                return fuzzy_action::hidden;
+        }
+        return fuzzy_action::bad;
+    }
+};
+
+/* The translation loop, mirroring `translate` in fputs.c. `lookup` fills in a
+ * `utf8totex_seq_t` for a code point and returns its type, as
+ * `utf8totex_from_char_ex` does.
+ */
+template <typename Sink, typename Lookup>
+constexpr int translate(std::string_view in, Sink &sink,
+        const utf8totex_options_t &options, utf8totex_char_t *error,
+        Lookup &&lookup) {
+
+    const char *s = in.data();
+    const char *const end = s + in.size();
+
+    /* The column of output we are at, for breaking lines. */
+    const std::size_t limit = options.line_limit;
+    std::size_t column = 0;
+
+    /* Set while a modifier is being applied to the token before it. */
+    bool hold = false;
+
+    fuzzy_machine fz;
+    fz.verbatim = options.verbatim;
+
+    auto out = [&](const char *p, std::size_t n) {
+        put(sink, p, n);
+        column += n;
+    };
+    auto copied = [&](char c) {
+        put(sink, &c, 1);
+        column = c == '\n' ? 0 : column + 1;
+    };
+    auto wrap = [&](std::size_t n) {
+        if (limit != 0 && column != 0 && column + n >= limit && !hold &&
+            fz.state == fuzzy_idle) {
+            put(sink, "%\n", 2);
+            column = 0;
+        }
+    };
+
+    /* The lookahead token, as in fputs.c. */
+    char ascii[2] = {0};
+    char modified[16] = {0};
+    const char *lookahead = nullptr;
+    std::size_t lookahead_len = 0;
+    unsigned lookahead_flags = 0;
+
+    /* The group of math mode sequences or Cyrillic letters being output, as
+     * in fputs.c.
+     */
+    char group = '\0';
+    bool group_ends_word = false;
+
+    auto close_group = [&] {
+        if (group != '\0') {
+            out(&group, 1);
+            group = '\0';
+        }
+    };
+
+    auto flush = [&](char next) {
+        if (lookahead == nullptr)
+            return;
+        if (lookahead != ascii &&
+            (options.coalesce_math ||
+             options.elide_braces != UTF8TOTEX_ELIDE_NONE ||
+             (lookahead_flags & UTF8TOTEX_SEQ_CYRILLIC))) {
+            const std::size_t len = lookahead_len;
+            char close = '\0';
+            if (options.coalesce_math &&
+                (lookahead_flags & UTF8TOTEX_SEQ_MATH)) {
+                close = '$';
+            } else if (lookahead_flags & UTF8TOTEX_SEQ_CYRILLIC) {
+                close = '}';
+            }
+            if (close != '\0') {
+                const char *body = lookahead + 1;
+                if (group != close) {
+                    close_group();
+                    wrap(len);
+                    out(lookahead, 1);
+                } else if (group_ends_word && is_letter(body[0])) {
+                    out(" ", 1);
+                }
+                out(body, len - 2);
+                group = close;
+                group_ends_word =
+                  (lookahead_flags & UTF8TOTEX_SEQ_CONTROL_WORD) != 0;
+                lookahead = nullptr;
+                return;
+            }
+            close_group();
+            if (options.elide_braces != UTF8TOTEX_ELIDE_NONE &&
+                can_elide(lookahead, len, next, options.elide_braces)) {
+                wrap(len - 2);
+                out(lookahead + 1, len - 2);
+                lookahead = nullptr;
+                return;
+            }
+        }
+        close_group();
+        if (lookahead == ascii) {
+            if (!is_space(ascii[0])) {
+                wrap(1);
+                copied(ascii[0]);
+            } else if (limit != 0 && column + 1 + long_word > limit &&
+                       ascii[0] != '\n' && !hold && fz.state == fuzzy_idle &&
+                       !is_space(next) && next != '\0' &&
+                       column + 1 + word_length(s, end, long_word) > limit) {
+                /* Break the line here rather than in the next word. */
+                put(sink, "\n", 1);
+                column = 0;
+            } else {
+                copied(ascii[0]);
+            }
+            lookahead = nullptr;
+            return;
+        }
+        wrap(lookahead_len);
+        out(lookahead, lookahead_len);
+        if ((lookahead_flags & (UTF8TOTEX_SEQ_MATH |
+                                UTF8TOTEX_SEQ_CONTROL_WORD)) ==
+              UTF8TOTEX_SEQ_CONTROL_WORD && is_letter(next))
+            out(" ", 1);
+        lookahead = nullptr;
+    };
+
+    auto put_char = [&](char c) {
+        close_group();
+        copied(c);
+    };
+
+    std::uint32_t c = 0;
+    int length;
+    while ((length = get_utf8_char(c, s, end)) != 0) {
+
+        if (length == -1)
+            return fail(error, UTF8TOTEX_INVALID);
+
+        bool separate = false;
+        bool math = false;
+        if (options.fuzzy && (fz.state != fuzzy_idle || c == '\\' ||
+                              c == '{' || c == '$')) {
+            if (length == 1) {
+                flush(static_cast<char>(c));
+                if (fz.state == fuzzy_idle) {
+                    close_group();
+                    wrap(1);
+                }
+            }
+
+            const fuzzy_action action = fz.step(*s);
+            if (action == fuzzy_action::bad)
+                return fail(error, UTF8TOTEX_BAD_LITERAL);
+
+            math = action == fuzzy_action::math_text ||
+                   action == fuzzy_action::math_word_text;
+            if (action != fuzzy_action::text &&
+                action != fuzzy_action::word_text && !math) {
+                if (action == fuzzy_action::tex && fz.state == fuzzy_braced &&
+                    is_letter(static_cast<char>(c))) {
+                    ascii[0] = static_cast<char>(c);
+                    lookahead = ascii;
+                    lookahead_len = 1;
+                    lookahead_flags = 0;
+                } else {
+                    for (int i = 0; i < length; i++)
+                        put_char(s[i]);
+                }
+                s += length;
+                continue;
+            }
+
+            separate = action == fuzzy_action::word_text ||
+                       action == fuzzy_action::math_word_text;
+        }
+
+        utf8totex_seq_t t{};
+        utf8totex_char_t type = lookup(t, c);
+        if (math && type == UTF8TOTEX_MODIFIER)
+            type = UTF8TOTEX_UNSUPPORTED;
+
+        switch (type) {
+            case UTF8TOTEX_ASCII:
+                flush(static_cast<char>(c));
+                ascii[0] = static_cast<char>(c);
+                lookahead = ascii;
+                lookahead_len = 1;
+                lookahead_flags = 0;
+                break;
+
+            case UTF8TOTEX_SEQUENCE:
+                if (math && (t.flags & UTF8TOTEX_SEQ_MATH)) {
+                    t.str++;
+                    t.len -= 2;
+                    t.flags &= ~UTF8TOTEX_SEQ_MATH;
+                } else if (math) {
+                    flush('\\');
+                    out("\\mbox{", 6);
+                    out(t.str, t.len);
+                    out("}", 1);
+                    break;
+                }
+                flush(t.str[0]);
+                if (separate && is_letter(t.str[0]))
+                    out(" ", 1);
+                lookahead = t.str;
+                lookahead_len = t.len;
+                lookahead_flags = t.flags;
+                break;
+
+            case UTF8TOTEX_MODIFIER: {
+                if (lookahead == nullptr || lookahead == modified)
+                    return fail(error, UTF8TOTEX_BAD_MODIFIER);
+
+                const bool dotless =
+                  (lookahead[0] == 'i' || lookahead[0] == 'j') &&
+                  (t.flags & UTF8TOTEX_SEQ_DOTLESS);
+
+                if (options.elide_braces != UTF8TOTEX_ELIDE_NONE &&
+                    lookahead == ascii &&
+                    t.len + dotless + 2 < sizeof(modified)) {
+                    char *p = modified;
+                    for (std::size_t i = 0; i < t.len; i++)
+                        *p++ = t.str[i];
+                    if (dotless)
+                        *p++ = '\\';
+                    *p++ = ascii[0];
+                    *p++ = '}';
+                    *p = '\0';
+                    lookahead = modified;
+                    lookahead_len = static_cast<std::size_t>(
+                      p - modified);
+                    lookahead_flags = 0;
+                    break;
+                }
+
+                close_group();
+                wrap(t.len + dotless + lookahead_len + 1);
+                hold = true;
+                out(t.str, t.len);
+                if (dotless)
+                    out("\\", 1);
+                flush('}');
+                put_char('}');
+                hold = false;
+                break;
+            }
+
+            default:
+                return fail(error, type);
+        }
+        s += length;
+    }
+
+    flush('\0');
+    close_group();
+    return 0;
+}
+
+} // namespace detail
+
+/**
+ * @brief Translate a UTF-8 string to an ASCII TeX string, appending the result
+ *        to a sink.
+ *
+ * The sink is either an object with an `append(const char*, std::size_t)`
+ * member, such as a `std::string` or `std::pmr::string`, or an output
+ * iterator, which is advanced past the output. Translating into a string with
+ * enough capacity reserved allocates nothing. As with the C interface, output
+ * up to the point of any failure is left in the sink. Exceptions thrown by the
+ * sink are propagated.
+ *
+ * @param in Input string. Translation stops early at any NUL.
+ * @param sink Where to write the output.
+ * @param options Translation options. Statistics, source maps and
+ *                transliteration are only supported by the C interface, so
+ *                `options.stats`, `options.srcmap` and `options.translit` must
+ *                be `NULL`.
+ * @param error Optional output pointer for the error value if there was one.
+ * @return `0` on success or `EOF` on failure.
+ */
+template <typename Sink>
+int translate(std::string_view in, Sink &&sink,
+        const utf8totex_options_t &options = utf8totex_options_t{},
+        utf8totex_char_t *error = nullptr) {
+    assert(options.stats == nullptr);
+    assert(options.srcmap == nullptr);
+    assert(options.translit == nullptr);
+
+    return detail::translate(in, sink, options, error,
+        [&options](utf8totex_seq_t &t, std::uint32_t c) {
+            if (options.map != nullptr &&
+                utf8totex_map_lookup(options.map, c, &t))
+                return UTF8TOTEX_SEQUENCE;
+            return utf8totex_from_char_ex(&t, c, options.env);
+        });
+}
+
+/**
+ * @brief Translate a contiguous range of UTF-8, such as a `std::vector<char>`
+ *        or `std::array<char, N>`, appending the result to a sink.
+ *
+ * See the `std::string_view` overload.
+ */
+template <typename Range, typename Sink,
+          typename = std::enable_if_t<
+            !std::is_convertible_v<const Range&, std::string_view> &&
+            std::is_same_v<std::remove_cv_t<std::remove_pointer_t<
+              decltype(std::data(std::declval<const Range&>()))>>, char>>>
+int translate(const Range &in, Sink &&sink,
+        const utf8totex_options_t &options = utf8totex_options_t{},
+        utf8totex_char_t *error = nullptr) {
+    return translate(std::string_view(std::data(in), std::size(in)),
+        std::forward<Sink>(sink), options, error);
+}
+
+#if __cplusplus >= 202002L
+
+namespace detail {
+
+/* Mirrors `seq_flags` in from_char.c. */
+constexpr unsigned seq_flags(const char *s, std::size_t len, bool modifier) {
+    if (modifier) {
+        if (len >= 3 && s[0] == '{' && s[1] == '\\') {
+            for (char accent : std::string_view("\"'.=^`~Hrtuv")) {
+                if (s[2] == accent)
+                    return UTF8TOTEX_SEQ_DOTLESS;
+            }
+        }
+        return 0;
+    }
+
+    if (len >= 7 && s[0] == '{' && s[1] == '\\' && s[len - 1] == '}' &&
+        (std::string_view(s + 2, 3) == "CYR" ||
+         std::string_view(s + 2, 3) == "cyr")) {
+        bool letters = true;
+        for (std::size_t i = 5; i < len - 1; i++)
+            letters = letters && is_letter(s[i]);
+        if (letters)
+            return UTF8TOTEX_SEQ_CYRILLIC;
+    }
+
+    if (len < 3 || s[0] != '$' || s[len - 1] != '$' ||
+        std::string_view(s + 1, len - 2).find('$') != std::string_view::npos)
+        return 0;
+    unsigned flags = UTF8TOTEX_SEQ_MATH;
+    std::size_t i = len - 1;
+    while (i > 1 && is_letter(s[i - 1]))
+        i--;
+    if (i < len - 1 && i > 1 && s[i - 1] == '\\')
+        flags |= UTF8TOTEX_SEQ_CONTROL_WORD;
+    return flags;
+}
+
+template <std::size_t N, std::size_t M>
+constexpr utf8totex_seq_t make_seq(const char (&str)[N],
+        const char (&ascii)[M], bool modifier) {
+    return utf8totex_seq_t{ str, N - 1, seq_flags(str, N - 1, modifier), ascii,
+                            M - 1 };
+}
+
+/* Features an environment provides, mirroring `env_features` in
+ * from_char.c.
+ */
+enum : unsigned {
+    needs_t1 = 1 << 0,
+    needs_textcomp = 1 << 1,
+    needs_cyrillic = 1 << 2,
+    needs_t2a = 1 << 3,
+};
+
+constexpr unsigned env_features(utf8totex_environment_t env) {
+    unsigned features = 0;
+    if (env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T1 ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2A ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2B ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2C ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_X2)
+        features |= needs_t1;
+    if (env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2A ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2B ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2C ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_X2 ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_OT2)
+        features |= needs_cyrillic;
+    if (env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_T2A ||
+        env.font_encoding == utf8totex_environment_t::UTF8TOTEX_FE_X2)
+        features |= needs_t2a;
+    if (env.textcomp)
+        features |= needs_textcomp;
+    return features;
+}
+
+/* The translation table as a constant expression, mirroring `lookup` in
+ * from_char.c.
+ */
+constexpr utf8totex_char_t table_lookup(utf8totex_seq_t &seq,
+        std::uint32_t c, unsigned &needs) {
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+    switch (c) {
+
+#define ASC(x) \
+    case x: do { \
+                return UTF8TOTEX_ASCII; \
+            } while (0)
+
+#define ASC_RANGE(x, y) \
+    case x ... y: do { \
+                      return UTF8TOTEX_ASCII; \
+                  } while (0)
+
+#define SEQ(x, str, ascii) \
+    case x: do { \
+                seq = make_seq(str, ascii, false); \
+                return UTF8TOTEX_SEQUENCE; \
+            } while (0)
+
+#define SEQ_T1(x, str, ascii) \
+    case x: do { \
+                seq = make_seq(str, ascii, false); \
+                needs = needs_t1; \
+                return UTF8TOTEX_SEQUENCE; \
+            } while (0)
+
+#define SEQ_TC(x, str, ascii) \
+    case x: do { \
+                seq = make_seq(str, ascii, false); \
+                needs = needs_textcomp; \
+                return UTF8TOTEX_SEQUENCE; \
+            } while (0)
+
+#define SEQ_CYR(x, str, ascii) \
+    case x: do { \
+                seq = make_seq(str, ascii, false); \
+                needs = needs_cyrillic; \
+                return UTF8TOTEX_SEQUENCE; \
+            } while (0)
+
+#define SEQ_T2A(x, str, ascii) \
+    case x: do { \
+                seq = make_seq(str, ascii, false); \
+                needs = needs_t2a; \
+                return UTF8TOTEX_SEQUENCE; \
+            } while (0)
+
+#define ENTRY(str, ascii) make_seq(str, ascii, false)
+
+#define SEQ_CYR_RANGE(x, y, ...) \
+    case x ... y: do { \
+                      constexpr utf8totex_seq_t range[] = { __VA_ARGS__ }; \
+                      static_assert(std::size(range) == (y) - (x) + 1, \
+                                    "range size mismatch"); \
+                      seq = range[c - (x)]; \
+                      needs = needs_cyrillic; \
+                      return UTF8TOTEX_SEQUENCE; \
+                  } while (0)
+
+#define ACC(x, str) \
+    case x: do { \
+                seq = make_seq(str, "", true); \
+                return UTF8TOTEX_MODIFIER; \
+            } while (0)
+
+#define UNS(x) \
+    case x: do { \
+                return UTF8TOTEX_UNSUPPORTED; \
+            } while (0)
+
+#define UNS_RANGE(x, y) \
+    case x ... y: do { \
+                      return UTF8TOTEX_UNSUPPORTED; \
+                  } while (0)
+
+#define INV(x) \
+    case x: do { \
+                return UTF8TOTEX_INVALID; \
+            } while (0)
+
+#define INV_RANGE(x, y) \
+    case x ... y: do { \
+                      return UTF8TOTEX_INVALID; \
+                  } while (0)
+
+#include "utf8totex/table.inc"
+
+#undef ASC
+#undef ASC_RANGE
+#undef SEQ
+#undef SEQ_T1
+#undef SEQ_TC
+#undef SEQ_CYR
+#undef SEQ_T2A
+#undef ENTRY
+#undef SEQ_CYR_RANGE
+#undef ACC
+#undef UNS
+#undef UNS_RANGE
+#undef INV
+#undef INV_RANGE
+
+        case 1u << 21 ... UINT32_MAX:
+            return UTF8TOTEX_INVALID;
+
+        default:
+            return UTF8TOTEX_UNSUPPORTED;
+    }
+
+#pragma GCC diagnostic pop
+}
+
+/* A string literal usable as a template argument. */
+template <std::size_t N>
+struct literal {
+    char str[N] = {};
+
+    consteval literal(const char (&s)[N]) {
+        for (std::size_t i = 0; i < N; i++)
+            str[i] = s[i];
+    }
+};
+
+/* Counts output rather than storing it. */
+struct counter {
+    std::size_t len = 0;
+
+    constexpr void append(const char*, std::size_t n) {
+        len += n;
+    }
+};
+
+/* Deliberately not `constexpr`, so that reaching one of these during constant
+ * evaluation is a compile error naming the problem.
+ */
+inline void invalid_utf8_in_literal() {}
+inline void unsupported_character_in_literal() {}
+inline void misplaced_modifier_in_literal() {}
+inline void non_ascii_tex_in_literal() {}
+
+template <literal S, utf8totex_options_t Options, typename Sink>
+constexpr void translate_literal(Sink &sink) {
+    utf8totex_char_t error = UTF8TOTEX_EOF;
+    int r = translate(std::string_view(S.str, sizeof(S.str) - 1), sink,
+        Options, &error,
+        [](utf8totex_seq_t &t, std::uint32_t c) {
+            unsigned needs = 0;
+            utf8totex_char_t type = table_lookup(t, c, needs);
+            if ((needs & ~env_features(Options.env)) != 0)
+                return UTF8TOTEX_UNSUPPORTED;
+            return type;
+        });
+    if (r != 0) {
+        switch (error) {
+            case UTF8TOTEX_INVALID:     invalid_utf8_in_literal();          break;
+            case UTF8TOTEX_BAD_MODIFIER: misplaced_modifier_in_literal();   break;
+            case UTF8TOTEX_BAD_LITERAL: non_ascii_tex_in_literal();         break;
+            default:                    unsupported_character_in_literal(); break;
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Translate a UTF-8 string literal to an ASCII TeX string at compile
+ *        time.
+ *
+ * For example, `translate_literal<"Café">()` is a `std::array` holding
+ * "Caf{\\'e}" and a NUL terminator. A literal that cannot be translated, such
+ * as one with a character unsupported in the target environment, is a compile
+ * error. Only available with C++20.
+ *
+ * @tparam S Input string literal.
+ * @tparam Options Translation options. Mapping overlays, statistics, source
+ *                 maps and transliteration are not supported.
+ * @return The translation followed by a NUL terminator.
+ */
+template <detail::literal S, utf8totex_options_t Options = utf8totex_options_t{}>
+consteval auto translate_literal() {
+    static_assert(Options.map == nullptr && Options.stats == nullptr &&
+                  Options.srcmap == nullptr && Options.translit == nullptr,
+                  "only translation options can be used at compile time");
+
+    constexpr std::size_t len = [] {
+        detail::counter c;
+        detail::translate_literal<S, Options>(c);
+        return c.len;
+    }();
+    std::array<char, len + 1> out{};
+    char *p = out.data();
+    detail::translate_literal<S, Options>(p);
+    return out;
+}
+
+#endif
+
+} // namespace utf8totex
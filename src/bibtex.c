@@ -0,0 +1,345 @@
+/* Streaming BibTeX scanner.
+ *
+ * This tracks just enough of the structure of a .bib file to distinguish field
+ * values from everything else. Entry types, citation keys, field names, macro
+ * references and comments are copied through unmodified while the contents of
+ * braced and quoted values are passed through `utf8totex_fputs` in fuzzy mode.
+ *
+ * Input can be fed in arbitrarily sized pieces. A value that spans multiple
+ * pieces is accumulated and translated in one go when its closing delimiter is
+ * seen, so the only memory this needs is proportional to the longest single
+ * value.
+ */
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "utf8totex/utf8totex.h"
+
+struct utf8totex_bibtex {
+    /* Options for translating values, always in fuzzy mode. */
+    utf8totex_options_t options;
+
+    enum {
+        OUTSIDE,
+            /**< Between entries; everything is a comment. */
+        ENTRY_TYPE,
+            /**< We've seen a '@' and are reading the entry type. */
+        KEY,
+            /**< Reading the citation key. */
+        FIELD_NAME,
+            /**< Reading a field name (or `@string` macro name). */
+        VALUE,
+            /**< After a '=' and between the pieces of a value. */
+        BRACED_VALUE,
+            /**< Inside a '{'-delimited value. */
+        QUOTED_VALUE,
+            /**< Inside a '"'-delimited value. */
+        VERBATIM,
+            /**< Inside an `@comment` or `@preamble` body. */
+    } state;
+
+    /* The character closing the current entry; either '}' or ')'. */
+    char closer;
+
+    /* Brace nesting within a value or verbatim body. */
+    unsigned depth;
+
+    /* Entry type read so far. We only need enough to recognise the handful of
+     * special entry types, so anything longer is truncated.
+     */
+    char type[sizeof("preamble")];
+    size_t type_len;
+
+    /* Accumulated contents of the value currently being read. */
+    char *value;
+    size_t value_len;
+    size_t value_size;
+};
+
+utf8totex_bibtex_t *utf8totex_bibtex_new(utf8totex_environment_t env) {
+    utf8totex_options_t options = UTF8TOTEX_DEFAULT_OPTIONS;
+    options.env = env;
+    return utf8totex_bibtex_new_opt(options);
+}
+
+utf8totex_bibtex_t *utf8totex_bibtex_new_opt(utf8totex_options_t options) {
+    utf8totex_bibtex_t *b = calloc(1, sizeof(*b));
+    if (b == NULL)
+        return NULL;
+    /* Each value is translated on its own, so none of these would line up
+     * with the database as a whole.
+     */
+    options.fuzzy = true;
+    options.line_limit = 0;
+    options.srcmap = NULL;
+    options.translit = NULL;
+    b->options = options;
+    b->state = OUTSIDE;
+    return b;
+}
+
+void utf8totex_bibtex_free(utf8totex_bibtex_t *b) {
+    if (b == NULL)
+        return;
+    free(b->value);
+    free(b);
+}
+
+static int append_value(utf8totex_bibtex_t *b, const char *s, size_t n) {
+    if (b->value_len + n + 1 > b->value_size) {
+        size_t size = b->value_size == 0 ? 128 : b->value_size;
+        while (b->value_len + n + 1 > size)
+            size *= 2;
+        char *p = realloc(b->value, size);
+        if (p == NULL)
+            return -1;
+        b->value = p;
+        b->value_size = size;
+    }
+    memcpy(b->value + b->value_len, s, n);
+    b->value_len += n;
+    b->value[b->value_len] = '\0';
+    return 0;
+}
+
+int utf8totex_bibtex_fputs(utf8totex_bibtex_t *b, const char *s, FILE *f,
+        utf8totex_char_t *error) {
+    assert(b != NULL);
+    assert(s != NULL);
+    assert(f != NULL);
+
+#define ERR(code) \
+    do { \
+        if (error != NULL) { \
+            *error = UTF8TOTEX_ ## code; \
+        } \
+        return EOF; \
+    } while (0)
+
+#define PUTC(c) \
+    do { \
+        if (fputc((c), f) == EOF) { \
+            ERR(EOF); \
+        } \
+    } while (0)
+
+#define WRITE(p, n) \
+    do { \
+        if ((n) > 0 && fwrite((p), 1, (n), f) != (n)) { \
+            ERR(EOF); \
+        } \
+    } while (0)
+
+    /* Most states jump straight to the next delimiter of interest with
+     * `strcspn`, letting libc use its vectorised implementation instead of us
+     * looking at every byte.
+     */
+    while (*s != '\0') {
+        switch (b->state) {
+
+            case OUTSIDE: {
+                size_t n = strcspn(s, "@");
+                WRITE(s, n);
+                s += n;
+                if (*s == '@') {
+                    PUTC('@');
+                    s++;
+                    b->type_len = 0;
+                    b->state = ENTRY_TYPE;
+                }
+                break;
+
+            } case ENTRY_TYPE: {
+                char c = *s;
+                if (c == '{' || c == '(') {
+                    PUTC(c);
+                    s++;
+                    b->closer = c == '{' ? '}' : ')';
+                    b->type[b->type_len] = '\0';
+                    b->depth = 0;
+                    if (strcasecmp(b->type, "comment") == 0 ||
+                        strcasecmp(b->type, "preamble") == 0) {
+                        b->state = VERBATIM;
+                    } else if (strcasecmp(b->type, "string") == 0) {
+                        b->state = FIELD_NAME;
+                    } else {
+                        b->state = KEY;
+                    }
+                } else if (isspace((unsigned char)c) ||
+                           isalnum((unsigned char)c) || c == '_' || c == '-') {
+                    if (!isspace((unsigned char)c) &&
+                        b->type_len < sizeof(b->type) - 1)
+                        b->type[b->type_len++] = c;
+                    PUTC(c);
+                    s++;
+                } else {
+                    /* Not an entry after all. */
+                    b->state = OUTSIDE;
+                }
+                break;
+
+            } case KEY: {
+                size_t n = strcspn(s, b->closer == ')' ? ",)" : ",}");
+                WRITE(s, n);
+                s += n;
+                if (*s == ',') {
+                    PUTC(',');
+                    s++;
+                    b->state = FIELD_NAME;
+                } else if (*s == b->closer) {
+                    PUTC(*s);
+                    s++;
+                    b->state = OUTSIDE;
+                }
+                break;
+
+            } case FIELD_NAME: {
+                size_t n = strcspn(s, b->closer == ')' ? ",=)" : ",=}");
+                WRITE(s, n);
+                s += n;
+                if (*s == '=') {
+                    PUTC('=');
+                    s++;
+                    b->state = VALUE;
+                } else if (*s == ',') {
+                    PUTC(',');
+                    s++;
+                } else if (*s == b->closer) {
+                    PUTC(*s);
+                    s++;
+                    b->state = OUTSIDE;
+                }
+                break;
+
+            } case VALUE: {
+                char c = *s;
+                if (c == '{' || c == '"') {
+                    PUTC(c);
+                    s++;
+                    b->depth = 0;
+                    b->value_len = 0;
+                    b->state = c == '{' ? BRACED_VALUE : QUOTED_VALUE;
+                } else if (c == ',') {
+                    PUTC(',');
+                    s++;
+                    b->state = FIELD_NAME;
+                } else if (c == b->closer) {
+                    PUTC(c);
+                    s++;
+                    b->state = OUTSIDE;
+                } else {
+                    /* Whitespace, '#' concatenation, numbers and macro
+                     * references.
+                     */
+                    PUTC(c);
+                    s++;
+                }
+                break;
+
+            } case BRACED_VALUE:
+              case QUOTED_VALUE: {
+                const char *stop = b->state == BRACED_VALUE ? "{}" : "{}\"";
+                size_t n = strcspn(s, stop);
+                if (append_value(b, s, n) != 0)
+                    ERR(EOF);
+                s += n;
+                char c = *s;
+                if (c == '\0')
+                    break;
+                s++;
+
+                bool end = false;
+                if (c == '{') {
+                    b->depth++;
+                } else if (c == '}') {
+                    if (b->depth > 0) {
+                        b->depth--;
+                    } else {
+                        /* The end of a braced value. A stray '}' in a quoted
+                         * value is just text.
+                         */
+                        end = b->state == BRACED_VALUE;
+                    }
+                } else {
+                    assert(c == '"');
+                    end = b->depth == 0;
+                }
+
+                if (!end) {
+                    if (append_value(b, &c, 1) != 0)
+                        ERR(EOF);
+                    break;
+                }
+
+                if (b->value_len > 0 &&
+                    utf8totex_fputs_opt(b->value, b->options, f, error) != 0)
+                    return EOF;
+                PUTC(c);
+                b->value_len = 0;
+                b->state = VALUE;
+                break;
+
+            } case VERBATIM: {
+                /* Only the bracket type that opened the entry matters for
+                 * finding its end.
+                 */
+                char opener = b->closer == ')' ? '(' : '{';
+                size_t n = strcspn(s, b->closer == ')' ? "()" : "{}");
+                WRITE(s, n);
+                s += n;
+                char c = *s;
+                if (c == '\0')
+                    break;
+                PUTC(c);
+                s++;
+                if (c == opener) {
+                    b->depth++;
+                } else if (b->depth == 0) {
+                    b->state = OUTSIDE;
+                } else {
+                    b->depth--;
+                }
+                break;
+            }
+
+        }
+    }
+
+#undef WRITE
+#undef PUTC
+#undef ERR
+
+    return 0;
+}
+
+int utf8totex_bibtex_finish(utf8totex_bibtex_t *b, FILE *f,
+        utf8totex_char_t *error) {
+    assert(b != NULL);
+    assert(f != NULL);
+
+    /* If the input ended mid-value, flush what we have untranslated rather than
+     * silently dropping it.
+     */
+    if (b->state == BRACED_VALUE || b->state == QUOTED_VALUE) {
+        if (b->value_len > 0 &&
+            fwrite(b->value, 1, b->value_len, f) != b->value_len) {
+            if (error != NULL)
+                *error = UTF8TOTEX_EOF;
+            return EOF;
+        }
+        b->value_len = 0;
+        b->state = OUTSIDE;
+        if (error != NULL)
+            *error = UTF8TOTEX_INVALID;
+        return EOF;
+    }
+
+    b->state = OUTSIDE;
+    return 0;
+}
@@ -0,0 +1,344 @@
+/* Incremental re-translation.
+ *
+ * A document keeps its input, its translated output and a list of checkpoints.
+ * Each checkpoint records a position in the input, the corresponding position
+ * in the output, and the fuzzy mode state machine's state and the output column
+ * there. Checkpoints are placed immediately before ASCII spaces and newlines
+ * (see the comment at the top of parallel.c), at which point the lookahead
+ * token has always just been flushed and any coalesced math group closed.
+ * Translation can therefore restart at any checkpoint given only its state.
+ *
+ * After an edit, we restart from the last checkpoint before the edit and keep
+ * going until we reach an old checkpoint beyond the edit at which the state
+ * matches what was recorded there. Everything from that point onwards is
+ * unchanged, so the cost of an edit is proportional to its size rather than to
+ * the size of the document.
+ */
+
+#include <assert.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "utf8totex/utf8totex.h"
+
+/* Approximate spacing of checkpoints in bytes of input. */
+#define INTERVAL 4096
+
+typedef struct {
+    size_t in;
+    size_t out;
+    fuzzy_state_t fuzzy;
+} checkpoint_t;
+
+typedef struct {
+    checkpoint_t *v;
+    size_t len;
+    size_t size;
+} checkpoints_t;
+
+struct utf8totex_document {
+    utf8totex_options_t options;
+
+    /* Can we place checkpoints at all? */
+    bool cuttable;
+
+    char *input;
+    size_t input_len;
+    size_t input_size;
+
+    char *output;
+    size_t output_len;
+    size_t output_size;
+
+    checkpoints_t checkpoints;
+
+    /* Inserted text of the last patch returned. */
+    char *patch;
+};
+
+static int push(checkpoints_t *cps, checkpoint_t cp) {
+    if (cps->len == cps->size) {
+        size_t size = cps->size == 0 ? 16 : cps->size * 2;
+        checkpoint_t *v = realloc(cps->v, size * sizeof(v[0]));
+        if (v == NULL)
+            return -1;
+        cps->v = v;
+        cps->size = size;
+    }
+    cps->v[cps->len++] = cp;
+    return 0;
+}
+
+static bool is_cut(char c) {
+    return c == ' ' || c == '\n';
+}
+
+/* Translate the input from `start` to `stop`, starting in state `*fuzzy`.
+ * Output is written to `f` and a checkpoint appended to `cps` for each cut made
+ * along the way, with output offsets relative to the start of `f`. `stop` must
+ * be either the end of the input or a valid cut point.
+ */
+static int translate_from(utf8totex_document_t *d, size_t start, size_t stop,
+        fuzzy_state_t *fuzzy, FILE *f, checkpoints_t *cps,
+        utf8totex_char_t *error) {
+
+    for (size_t at = start; at < stop; ) {
+        size_t cut = stop;
+        if (d->cuttable && stop - at > INTERVAL) {
+            cut = at + INTERVAL;
+            while (cut < stop && !is_cut(d->input[cut]))
+                cut++;
+        }
+
+        const char *end = cut == d->input_len ? NULL : d->input + cut;
+        if (fputs_range(d->input + at, end, d->options, f, error, fuzzy) != 0)
+            return EOF;
+
+        if (cut < stop) {
+            off_t out = ftello(f);
+            if (out == (off_t)-1 ||
+                push(cps, (checkpoint_t){ cut, (size_t)out, *fuzzy }) != 0) {
+                if (error != NULL)
+                    *error = UTF8TOTEX_EOF;
+                return EOF;
+            }
+        }
+        at = cut;
+    }
+
+    return 0;
+}
+
+utf8totex_document_t *utf8totex_document_new(const char *s,
+        utf8totex_options_t options, utf8totex_char_t *error) {
+    assert(s != NULL);
+
+    utf8totex_document_t *d = calloc(1, sizeof(*d));
+    if (d == NULL)
+        goto fail;
+
+    d->options = options;
+    /* Re-translated regions would be appended out of order. */
+    d->options.srcmap = NULL;
+    d->options.translit = NULL;
+    d->cuttable = can_cut_at_spaces(options);
+    d->input = strdup(s);
+    if (d->input == NULL)
+        goto fail;
+    d->input_len = strlen(s);
+    d->input_size = d->input_len + 1;
+
+    if (push(&d->checkpoints, (checkpoint_t){ 0, 0, { 0 } }) != 0)
+        goto fail;
+
+    FILE *f = open_memstream(&d->output, &d->output_len);
+    if (f == NULL)
+        goto fail;
+    fuzzy_state_t fuzzy = { 0 };
+    int r = translate_from(d, 0, d->input_len, &fuzzy, f, &d->checkpoints,
+        error);
+    if (fclose(f) != 0 && r == 0)
+        goto fail;
+    if (r != 0) {
+        utf8totex_document_free(d);
+        return NULL;
+    }
+    d->output_size = d->output_len + 1;
+
+    return d;
+
+fail:
+    if (error != NULL)
+        *error = UTF8TOTEX_EOF;
+    utf8totex_document_free(d);
+    return NULL;
+}
+
+const char *utf8totex_document_output(const utf8totex_document_t *d,
+        size_t *len) {
+    assert(d != NULL);
+
+    if (len != NULL)
+        *len = d->output_len;
+    return d->output;
+}
+
+/* Replace `removed` bytes at `offset` in a buffer of length `*len` and
+ * allocated size `*size` with `inserted_len` bytes from `inserted`, keeping it
+ * NUL-terminated. Buffers are never shrunk, so undoing a splice cannot fail.
+ */
+static int splice(char **buffer, size_t *len, size_t *size, size_t offset,
+        size_t removed, const char *inserted, size_t inserted_len) {
+    assert(offset + removed <= *len);
+
+    size_t new_len = *len - removed + inserted_len;
+    if (new_len + 1 > *size) {
+        size_t new_size = *size * 2 > new_len + 1 ? *size * 2 : new_len + 1;
+        char *p = realloc(*buffer, new_size);
+        if (p == NULL)
+            return -1;
+        *buffer = p;
+        *size = new_size;
+    }
+    memmove(*buffer + offset + inserted_len, *buffer + offset + removed,
+        *len - offset - removed + 1);
+    memcpy(*buffer + offset, inserted, inserted_len);
+    *len = new_len;
+    return 0;
+}
+
+int utf8totex_document_edit(utf8totex_document_t *d, size_t offset,
+        size_t removed, const char *inserted, utf8totex_patch_t *patch,
+        utf8totex_char_t *error) {
+    assert(d != NULL);
+    assert(inserted != NULL);
+
+    if (offset > d->input_len || removed > d->input_len - offset) {
+        if (error != NULL)
+            *error = UTF8TOTEX_INVALID;
+        return EOF;
+    }
+
+    size_t inserted_len = strlen(inserted);
+
+    /* Keep what we remove, in case we need to roll back. */
+    char *saved = malloc(removed + 1);
+    if (saved == NULL)
+        goto oom;
+    memcpy(saved, d->input + offset, removed);
+    if (splice(&d->input, &d->input_len, &d->input_size, offset, removed,
+               inserted, inserted_len) != 0) {
+        free(saved);
+        goto oom;
+    }
+
+    const checkpoints_t *old = &d->checkpoints;
+
+    /* The last checkpoint strictly before the edit. The one at 0 always
+     * qualifies unless the edit is at the very start.
+     */
+    size_t k = 0;
+    while (k + 1 < old->len && old->v[k + 1].in < offset)
+        k++;
+
+    /* The first checkpoint after the edit we can hope to converge at. */
+    size_t j = k + 1;
+    while (j < old->len && old->v[j].in < offset + removed)
+        j++;
+
+    char *buffer = NULL;
+    size_t buffer_len = 0;
+    checkpoints_t fresh = { 0 };
+    FILE *f = open_memstream(&buffer, &buffer_len);
+    if (f == NULL)
+        goto rollback_oom;
+
+    fuzzy_state_t fuzzy = old->v[k].fuzzy;
+    size_t at = old->v[k].in;
+    for (;;) {
+        size_t stop = j < old->len ? old->v[j].in - removed + inserted_len
+                                   : d->input_len;
+        if (translate_from(d, at, stop, &fuzzy, f, &fresh, error) != 0) {
+            fclose(f);
+            goto rollback;
+        }
+        if (j == old->len)
+            break;
+        if (fuzzy_state_equal(&fuzzy, &old->v[j].fuzzy))
+            break;
+
+        /* Not converged yet. Keep this checkpoint, but with its new state. */
+        off_t out = ftello(f);
+        if (out == (off_t)-1 ||
+            push(&fresh, (checkpoint_t){ stop, (size_t)out, fuzzy }) != 0) {
+            fclose(f);
+            goto rollback_oom;
+        }
+        at = stop;
+        j++;
+    }
+    if (fclose(f) != 0)
+        goto rollback_oom;
+
+    /* Apply the change to our output. */
+    size_t out_start = old->v[k].out;
+    size_t out_end = j < old->len ? old->v[j].out : d->output_len;
+    if (splice(&d->output, &d->output_len, &d->output_size, out_start,
+               out_end - out_start, buffer, buffer_len) != 0)
+        goto rollback_oom;
+
+    /* Rebuild the checkpoint list: those up to `k` are unchanged, then the
+     * fresh ones, then those from `j` onwards shifted.
+     */
+    size_t tail = old->len - j;
+    size_t len = k + 1 + fresh.len + tail;
+    if (len > d->checkpoints.size) {
+        checkpoint_t *v = realloc(d->checkpoints.v, len * sizeof(v[0]));
+        if (v == NULL) {
+            /* Our output is already updated, so we cannot roll back. Fall back
+             * to forgetting the checkpoints after the edit, which is always
+             * correct, just slower next time.
+             */
+            d->checkpoints.len = k + 1;
+            goto done;
+        }
+        d->checkpoints.v = v;
+        d->checkpoints.size = len;
+    }
+    memmove(&d->checkpoints.v[k + 1 + fresh.len], &d->checkpoints.v[j],
+        tail * sizeof(checkpoint_t));
+    for (size_t i = k + 1 + fresh.len; i < len; i++) {
+        d->checkpoints.v[i].in = d->checkpoints.v[i].in - removed +
+            inserted_len;
+        d->checkpoints.v[i].out = d->checkpoints.v[i].out - out_end +
+            out_start + buffer_len;
+    }
+    for (size_t i = 0; i < fresh.len; i++) {
+        fresh.v[i].out += out_start;
+        d->checkpoints.v[k + 1 + i] = fresh.v[i];
+    }
+    d->checkpoints.len = len;
+
+done:
+    if (patch != NULL) {
+        patch->offset = out_start;
+        patch->removed = out_end - out_start;
+        patch->inserted = buffer;
+        patch->inserted_len = buffer_len;
+    }
+    free(d->patch);
+    d->patch = buffer;
+    free(fresh.v);
+    free(saved);
+    return 0;
+
+rollback_oom:
+    if (error != NULL)
+        *error = UTF8TOTEX_EOF;
+rollback:
+    free(buffer);
+    free(fresh.v);
+    (void)splice(&d->input, &d->input_len, &d->input_size, offset,
+        inserted_len, saved, removed);
+    free(saved);
+    return EOF;
+
+oom:
+    if (error != NULL)
+        *error = UTF8TOTEX_EOF;
+    return EOF;
+}
+
+void utf8totex_document_free(utf8totex_document_t *d) {
+    if (d == NULL)
+        return;
+    free(d->patch);
+    free(d->checkpoints.v);
+    free(d->output);
+    free(d->input);
+    free(d);
+}
@@ -7,207 +7,796 @@
 #include <string.h>
 #include "utf8totex/utf8totex.h"
 
+static bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Is this a character that, following a control word, would either become
+ * part of its name or be swallowed as the space terminating it? A NUL means we
+ * don't know what comes next, so we have to assume the worst.
+ */
+static bool merges_with_control_word(char next) {
+    return next == '\0' || is_letter(next) || next == ' ' || next == '\t' ||
+           next == '\n' || next == '\r';
+}
+
+/* Control symbols that take an argument and hence must never lose their
+ * braces.
+ */
+static bool is_accent_symbol(char c) {
+    return c == '"' || c == '\'' || c == '.' || c == '=' || c == '^' ||
+           c == '`' || c == '~';
+}
+
+/* Control words that produce a letter rather than a symbol. For the purposes of
+ * sorting in bibliographies, these need to stay within braces (see the comment
+ * at the top of from_char.c).
+ */
+static bool is_letter_word(const char *name, size_t len) {
+    static const char *const letters[] = { "AA", "aa", "AE", "ae", "DH", "dh",
+        "DJ", "dj", "i", "j", "L", "l", "NG", "ng", "O", "o", "OE", "oe", "SS",
+        "ss", "TH", "th" };
+    for (size_t i = 0; i < sizeof(letters) / sizeof(letters[0]); i++) {
+        if (strlen(letters[i]) == len && strncmp(letters[i], name, len) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Determine whether the enclosing braces of the sequence `t` can be dropped
+ * without changing its meaning, given the byte that will be output after it.
+ */
+static bool can_elide(const char *t, size_t len, char next,
+        utf8totex_elide_t mode) {
+
+    /* We only deal with sequences of the form "{\...}". */
+    if (len < 4 || t[0] != '{' || t[1] != '\\' || t[len - 1] != '}')
+        return false;
+
+    const char *inner = t + 2;
+    size_t inner_len = len - 3;
+
+    /* A control symbol, e.g. "{\#}". */
+    if (inner_len == 1 && !is_letter(inner[0]))
+        return !is_accent_symbol(inner[0]);
+
+    /* A control word, e.g. "{\textless}". */
+    size_t word = 0;
+    while (word < inner_len && is_letter(inner[word]))
+        word++;
+    if (word == inner_len) {
+        if (mode != UTF8TOTEX_ELIDE_ALL && is_letter_word(inner, inner_len))
+            return false;
+        return !merges_with_control_word(next);
+    }
+
+    /* Anything further is an accented letter, which we only touch when the
+     * caller has indicated they do not care about bibliography sorting.
+     */
+    if (mode != UTF8TOTEX_ELIDE_ALL)
+        return false;
+
+    /* "{\'e}", "{\'\i}" or "{\c c}" */
+    size_t arg;
+    if (word == 0 && is_accent_symbol(inner[0])) {
+        arg = 1;
+    } else if (word == 1 && inner[1] == ' ') {
+        arg = 2;
+    } else {
+        return false;
+    }
+    if (inner_len == arg + 1 && is_letter(inner[arg]))
+        return next != '\0' && !is_letter(next);
+    if (inner_len == arg + 2 && inner[arg] == '\\' &&
+        (inner[arg + 1] == 'i' || inner[arg + 1] == 'j'))
+        return !merges_with_control_word(next);
+    return false;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* The longest word worth looking ahead for when deciding whether to break a line
+ * at the space before it. Only once the line is within this of its limit is
+ * the next word measured, so most spaces cost nothing extra. A longer word is
+ * broken with a '%' instead.
+ */
+#define LONG_WORD 64
+
+/* Length of the word starting at `s`, counting no further than `max`. */
+static size_t word_length(const char *s, size_t max) {
+    size_t n = 0;
+    while (n < max && s[n] != '\0' && !is_space(s[n]))
+        n++;
+    return n;
+}
+
 int utf8totex_fputs(const char *s, bool fuzzy, utf8totex_environment_t env,
         FILE *f, utf8totex_char_t *error) {
-    assert(s != NULL);
-    assert(f != NULL);
+    utf8totex_options_t options = UTF8TOTEX_DEFAULT_OPTIONS;
+    options.fuzzy = fuzzy;
+    options.env = env;
+    return utf8totex_fputs_opt(s, options, f, error);
+}
+
+/* Write to whichever of `f` and `sink` is in use, returning `0` on success. */
+static inline __attribute__((always_inline)) int emit(FILE *f, sink_t *sink,
+        const char *p, size_t n) {
+    if (f != NULL)
+        return fwrite(p, 1, n, f) == n ? 0 : EOF;
+    if (sink->size - sink->len < n && sink->grow(sink, n) != 0)
+        return EOF;
+    memcpy(sink->buffer + sink->len, p, n);
+    sink->len += n;
+    return 0;
+}
+
+static inline __attribute__((always_inline)) int emit_char(FILE *f,
+        sink_t *sink, char c) {
+    if (f != NULL)
+        return fputc(c, f) == EOF ? EOF : 0;
+    return emit(NULL, sink, &c, 1);
+}
+
+/* The body of `fputs_range`, `fputs_multi` and `fputs_sink`. This is forcibly
+ * inlined into its callers for each combination of `stats`, `srcmap`,
+ * `translit` and `multi` being literal `NULL`s that matters, so that the common
+ * case of collecting neither statistics, a source map nor a transliteration for
+ * a single environment pays no cost for the features. Output goes to `f` or,
+ * when that is a literal `NULL`, to `sink`.
+ *
+ * `detail::translate` in include/utf8totex/utf8totex.hpp is a copy of this for
+ * the C++ interface; any change to the output here must be made there too, and
+ * test/differential.cpp checks that the two agree.
+ */
+static inline __attribute__((always_inline)) int translate(const char *s,
+        const char *end, utf8totex_options_t options, FILE *f, sink_t *sink,
+        utf8totex_char_t *error, fuzzy_state_t *resume,
+        utf8totex_stats_t *stats, utf8totex_srcmap_t *srcmap, FILE *translit,
+        multi_t *multi) {
+
+    const bool fuzzy = options.fuzzy;
+    const utf8totex_environment_t env = options.env;
+    const char *const base = s;
+
+    TRACE(fputs_entry, s, fuzzy);
+
+    /* Output written, for tracing only. */
+#ifdef UTF8TOTEX_TRACE
+    size_t traced_out = 0;
+#define TRACE_OUT(n) (traced_out += (n))
+#else
+#define TRACE_OUT(n) ((void)0)
+#endif
+
+#define RETURN(r) \
+    do { \
+        TRACE(fputs_return, (r), (size_t)(s - base), traced_out); \
+        return (r); \
+    } while (0)
 
 #define ERR(code) \
     do { \
+        TRACE(error, UTF8TOTEX_ ## code, (size_t)(s - base)); \
         if (error != NULL) { \
             *error = UTF8TOTEX_ ## code; \
         } \
-        return EOF; \
+        RETURN(EOF); \
+    } while (0)
+
+#define EMIT(p, n) (emit(f, sink, (p), (n)) != 0)
+#define EMIT_CHAR(c) (emit_char(f, sink, (c)) != 0)
+
+    /* The column of output we are at, for breaking lines. */
+    const size_t limit = options.line_limit;
+    size_t column = resume == NULL ? 0 : resume->column;
+
+    /* Account for output when collecting statistics or a source map. When
+     * these are `NULL` this compiles to nothing (see `fputs_range`). A single
+     * character copied through unchanged goes through `COUNT_COPIED` instead,
+     * as it does not need to be tracked for the source map.
+     */
+    size_t escaped = 0;
+#define COUNT_OUT(n) \
+    do { \
+        TRACE_OUT(n); \
+        if (stats != NULL) { \
+            stats->bytes_out += (n); \
+        } \
+        if (srcmap != NULL) { \
+            escaped += (n); \
+        } \
+        column += (n); \
+    } while (0)
+#define COUNT_COPIED(c) \
+    do { \
+        TRACE_OUT(1); \
+        if (stats != NULL) { \
+            stats->bytes_out++; \
+        } \
+        if (srcmap != NULL && hold) { \
+            escaped++; \
+        } \
+        column = (c) == '\n' ? 0 : column + 1; \
+    } while (0)
+
+    /* Source map recording. Most input is copied through, so to keep the cost
+     * of this down nothing is done for such input. Instead, a run of unchanged
+     * input is recorded when the escape following it begins, at which point its
+     * extent is implied by the escape's position. The escape itself is recorded
+     * once it has been output, with `escaped` counting its length. While `hold`
+     * is set, recording is deferred so that a token and a modifier applied to
+     * it can be recorded as a single escape.
+     */
+    const size_t in0 = srcmap == NULL ? 0 : srcmap->in;
+    bool hold = false;
+#define BEGIN_ESCAPE(p) \
+    do { \
+        if (srcmap != NULL && !hold) { \
+            size_t _in = in0 + (size_t)((p) - base); \
+            if (_in > srcmap->in && \
+                srcmap_sync(srcmap, _in, srcmap->out + (_in - srcmap->in), \
+                            true) != 0) { \
+                ERR(EOF); \
+            } \
+            escaped = 0; \
+        } \
+    } while (0)
+#define END_ESCAPE(p) \
+    do { \
+        if (srcmap != NULL && !hold) { \
+            if (srcmap_sync(srcmap, in0 + (size_t)((p) - base), \
+                            srcmap->out + escaped, false) != 0) { \
+                ERR(EOF); \
+            } \
+            escaped = 0; \
+        } \
+    } while (0)
+
+    /* Transliteration, written as each character is translated. TeX passed
+     * through from the input in fuzzy mode is reduced to its text by dropping
+     * control sequences other than escaped special characters, along with
+     * braces and math shifts. `tex` tracks where we are in a control sequence.
+     */
+    enum { TEX_TEXT, TEX_ESCAPE, TEX_NAME } tex = TEX_TEXT;
+#define TRANSLIT(p, n) \
+    do { \
+        if (translit != NULL && (n) > 0 && \
+            fwrite((p), 1, (n), translit) != (n)) { \
+            ERR(EOF); \
+        } \
+    } while (0)
+#define TRANSLIT_TEX(ch) \
+    do { \
+        if (translit == NULL) { \
+            break; \
+        } \
+        const char _t = (char)(ch); \
+        if (tex == TEX_ESCAPE) { \
+            tex = is_letter(_t) ? TEX_NAME : TEX_TEXT; \
+            if (strchr("#$%&_{}", _t) != NULL) { \
+                TRANSLIT(&_t, 1); \
+            } \
+            break; \
+        } \
+        if (tex == TEX_NAME) { \
+            if (is_letter(_t)) { \
+                break; \
+            } \
+            tex = TEX_TEXT; \
+            /* The space terminating a control word */ \
+            if (_t == ' ') { \
+                break; \
+            } \
+        } \
+        if (_t == '\\') { \
+            tex = TEX_ESCAPE; \
+        } else if (_t != '{' && _t != '}' && _t != '$') { \
+            TRANSLIT(&_t, 1); \
+        } \
+    } while (0)
+
+    /* Line breaking. Before outputting something `n` bytes long that starts at
+     * `p` in the input and would leave no room before the line limit for a
+     * '%', end the line with a comment so TeX sees no space. This is only done between tokens
+     * outside any TeX construct, and never before white space as TeX would
+     * skip it at the start of the next line. The inserted output is attributed
+     * to the input before it, taking a byte from any preceding run of
+     * unchanged input to keep that exact.
+     */
+#define WRAP(n, p) \
+    do { \
+        if (limit != 0 && column != 0 && column + (n) >= limit && !hold && \
+            fz.state == FUZZY_IDLE) { \
+            const char *_p = (p); \
+            if (srcmap != NULL && in0 + (size_t)(_p - base) > srcmap->in) { \
+                BEGIN_ESCAPE(_p - 1); \
+                escaped = 1; \
+            } \
+            if (EMIT("%\n", 2)) { \
+                ERR(EOF); \
+            } \
+            COUNT_OUT(2); \
+            column = 0; \
+            END_ESCAPE(_p); \
+        } \
     } while (0)
 
     /* Track a single token for lookahead. We need this in order to apply
      * modifiers (typically accents) to the previous token. `lookahead`, when
      * not `NULL` always points to either the last returned sequence from
-     * `utf8_from_char` or `_lookahead` if the last thing was an ASCII
-     * character. In the latter case, the ASCII character is in
-     * `_lookahead[0]`.
+     * `utf8_from_char`, `_lookahead` if the last thing was an ASCII character
+     * or `_modified` if the last thing was an ASCII character we have already
+     * applied a modifier to. In the second case, the ASCII character is in
+     * `_lookahead[0]`. `lookahead_len` and `lookahead_flags` give its length
+     * and `UTF8TOTEX_SEQ_*` flags.
      */
     char _lookahead[2] = {0};
+    char _modified[16];
     const char* lookahead = NULL;
-#define FLUSH_LOOKAHEAD() \
+    size_t lookahead_len = 0;
+    unsigned lookahead_flags = 0;
+
+    /* Where in the input the lookahead token starts, if it is not ASCII. */
+    const char *lookahead_at = NULL;
+
+    /* Runs of sequences that can share a group are output as one group: math
+     * mode sequences in one "$...$" when coalescing them, and Cyrillic letters
+     * in one "{...}". `group` is the character closing a group we have opened
+     * but not yet closed, if any, and `group_ends_word` is whether the last
+     * thing we output within it was a control word.
+     */
+    char group = '\0';
+    bool group_ends_word = false;
+
+#define CLOSE_GROUP() \
+    do { \
+        if (group != '\0') { \
+            if (EMIT_CHAR(group)) { \
+                ERR(EOF); \
+            } \
+            COUNT_OUT(1); \
+            group = '\0'; \
+            /* This belongs to the group before it. */ \
+            if (srcmap != NULL && !hold) { \
+                if (srcmap_sync(srcmap, srcmap->in, srcmap->out + escaped, \
+                                false) != 0) { \
+                    ERR(EOF); \
+                } \
+                escaped = 0; \
+            } \
+        } \
+    } while (0)
+
+    /* Flush the lookahead token, given the next byte we are about to output or
+     * NUL if this is unknown. Knowing what comes next lets us decide whether
+     * the lookahead's braces are necessary.
+     */
+#define FLUSH_LOOKAHEAD(next) \
     do { \
-        if (lookahead != NULL) { \
-            if (fputs(lookahead, f) == EOF) { \
-                ERR(INVALID); \
+        if (lookahead == NULL) { \
+            break; \
+        } \
+        if (lookahead != _lookahead && \
+            (options.coalesce_math || \
+             options.elide_braces != UTF8TOTEX_ELIDE_NONE || \
+             (lookahead_flags & UTF8TOTEX_SEQ_CYRILLIC))) { \
+            size_t _len = lookahead_len; \
+            char _close = '\0'; \
+            if (options.coalesce_math && \
+                (lookahead_flags & UTF8TOTEX_SEQ_MATH)) { \
+                _close = '$'; \
+            } else if (lookahead_flags & UTF8TOTEX_SEQ_CYRILLIC) { \
+                _close = '}'; \
+            } \
+            if (_close != '\0') { \
+                const char *_body = lookahead + 1; \
+                size_t _body_len = _len - 2; \
+                if (group != _close) { \
+                    CLOSE_GROUP(); \
+                    WRAP(_len, lookahead_at); \
+                } \
+                BEGIN_ESCAPE(lookahead_at); \
+                if (group != _close) { \
+                    if (EMIT_CHAR(lookahead[0])) { \
+                        ERR(EOF); \
+                    } \
+                    COUNT_OUT(1); \
+                } else if (group_ends_word && is_letter(_body[0])) { \
+                    if (EMIT_CHAR(' ')) { \
+                        ERR(EOF); \
+                    } \
+                    COUNT_OUT(1); \
+                } \
+                if (EMIT(_body, _body_len)) { \
+                    ERR(EOF); \
+                } \
+                COUNT_OUT(_body_len); \
+                group = _close; \
+                group_ends_word = \
+                  (lookahead_flags & UTF8TOTEX_SEQ_CONTROL_WORD) != 0; \
+                END_ESCAPE(s); \
+                lookahead = NULL; \
+                break; \
+            } \
+            CLOSE_GROUP(); \
+            if (options.elide_braces != UTF8TOTEX_ELIDE_NONE && \
+                can_elide(lookahead, _len, (next), options.elide_braces)) { \
+                WRAP(_len - 2, lookahead_at); \
+                BEGIN_ESCAPE(lookahead_at); \
+                if (EMIT(lookahead + 1, _len - 2)) { \
+                    ERR(EOF); \
+                } \
+                COUNT_OUT(_len - 2); \
+                END_ESCAPE(s); \
+                lookahead = NULL; \
+                break; \
+            } \
+        } \
+        CLOSE_GROUP(); \
+        if (lookahead == _lookahead) { \
+            char _c = _lookahead[0]; \
+            if (!is_space(_c)) { \
+                WRAP(1, s - 1); \
+            } else if (limit != 0 && column + 1 + LONG_WORD > limit && \
+                       _c != '\n' && !hold && fz.state == FUZZY_IDLE && \
+                       !is_space((next)) && (next) != '\0' && \
+                       column + 1 + word_length(s, LONG_WORD) > limit) { \
+                /* Break the line here rather than in the next word. */ \
+                _c = '\n'; \
+                BEGIN_ESCAPE(s - 1); \
+            } \
+            if (EMIT_CHAR(_c)) { \
+                ERR(EOF); \
+            } \
+            if (_c != _lookahead[0]) { \
+                COUNT_OUT(1); \
+                column = 0; \
+                END_ESCAPE(s); \
+            } else { \
+                COUNT_COPIED(_c); \
             } \
             lookahead = NULL; \
+            break; \
         } \
+        WRAP(lookahead_len, lookahead_at); \
+        BEGIN_ESCAPE(lookahead_at); \
+        if (EMIT(lookahead, lookahead_len)) { \
+            ERR(EOF); \
+        } \
+        COUNT_OUT(lookahead_len); \
+        /* A sequence translated for math mode may end in a control word. */ \
+        if ((lookahead_flags & (UTF8TOTEX_SEQ_MATH | \
+                                UTF8TOTEX_SEQ_CONTROL_WORD)) == \
+              UTF8TOTEX_SEQ_CONTROL_WORD && is_letter((next))) { \
+            if (EMIT_CHAR(' ')) { \
+                ERR(EOF); \
+            } \
+            COUNT_OUT(1); \
+        } \
+        END_ESCAPE(s); \
+        lookahead = NULL; \
     } while (0)
 
 #define PUTC(c) \
     do { \
-        if (fputc((c), f) == EOF) { \
+        CLOSE_GROUP(); \
+        if (EMIT_CHAR(c)) { \
             ERR(EOF); \
         } \
+        COUNT_COPIED(c); \
     } while (0)
 
-    /* Setup for a state machine. Note that this is only used if `fuzzy` is
-     * `true`.
+    /* The fuzzy mode state machine. See fuzzy.c. `fz.column` is unused in
+     * favour of `column`.
      */
-    unsigned brace_depth = 0;
-    enum {
-        IDLE,
-            /**< Start state; no knowledge */
-        MACRO,
-            /**< In a macro invocation (we've seen '\' and now reading ASCII
-                 characters). */
-        BRACED,
-            /**< We've seen a '{' (either while in `IDLE` or `MACRO`) and now
-                 outputting literals while looking for a matching '}'. */
-        MATH,
-            /**< We've seen a '$' and now outputting literals while looking for
-                 another '$'. */
-    } state = IDLE;
+    fuzzy_state_t fz = { 0 };
+    if (resume != NULL)
+        fz = *resume;
 
     uint32_t c;
     int length;
-    while ((length = get_utf8_char(&c, s)) != 0) {
+    while (s != end && (length = get_utf8_char(&c, s)) != 0) {
         assert(length <= 4);
 
-        if (length == -1)
+        if (length == -1) {
+            if (stats != NULL)
+                stats->invalid++;
             ERR(INVALID);
+        }
 
-        switch (state) {
-
-            case IDLE: {
-                if (fuzzy) {
-                    if (c == L'\\') {
-                        FLUSH_LOOKAHEAD();
-                        PUTC('\\');
-                        state = MACRO;
-                        break;
-                    } else if (c == L'{') {
-                        FLUSH_LOOKAHEAD();
-                        PUTC('{');
-                        state = BRACED;
-                        assert(brace_depth == 0);
-                        brace_depth = 1;
-                        break;
-                    } else if (c == L'$') {
-                        FLUSH_LOOKAHEAD();
-                        PUTC('$');
-                        state = MATH;
-                        break;
-                    }
+        if (stats != NULL)
+            stats->bytes_in += (unsigned)length;
+
+        /* In fuzzy mode, anything but text outside TeX goes through the state
+         * machine.
+         */
+        bool separate = false;
+        bool math = false;
+        if (fuzzy && (fz.state != FUZZY_IDLE || c == L'\\' || c == L'{' ||
+                      c == L'$')) {
+            if (length == 1) {
+                FLUSH_LOOKAHEAD(c);
+                if (fz.state == FUZZY_IDLE) {
+                    CLOSE_GROUP();
+                    WRAP(1, s);
                 }
+            }
 
-                const char *t;
-                utf8totex_char_t type = utf8totex_from_char(&t, c, env);
-
-                switch (type) {
-                    case UTF8TOTEX_ASCII:
-                        FLUSH_LOOKAHEAD();
-                        _lookahead[0] = c;
-                        lookahead = _lookahead;
-                        break;
-
-                    case UTF8TOTEX_SEQUENCE:
-                        FLUSH_LOOKAHEAD();
-                        lookahead = t;
-                        break;
-
-                    case UTF8TOTEX_MODIFIER:
-                        if (lookahead == NULL)
-                            ERR(BAD_MODIFIER);
-
-                        /* Work around older versions of LaTeX that do not know to drop
-                         * overhead dot on an 'i' or 'j' when inserting an accent.
-                         */
-                        const char *prefix = "";
-                        if ((lookahead[0] == 'i' || lookahead[0] == 'j') &&
-                            strncmp(t, "{\\", sizeof("{\\") - 1) == 0 &&
-                            (t[2] == '"' || t[2] == '\'' || t[2] == '.' ||
-                             t[2] == '=' || t[2] == '^' || t[2] == '`' ||
-                             t[2] == '~' || t[2] == 'H' || t[2] == 'r' ||
-                             t[2] == 't' || t[2] == 'u' || t[2] == 'v'))
-                            prefix = "\\";
-
-                        if (fprintf(f, "%s%s", t, prefix) < 0)
-                            ERR(EOF);
-                        FLUSH_LOOKAHEAD();
-                        PUTC('}');
-                        break;
-
-                    case UTF8TOTEX_UNSUPPORTED:
-                    case UTF8TOTEX_INVALID:
-                        if (error != NULL)
-                            *error = type;
-                        return EOF;
-
-                    default:
-                        /* These are never returned by `utf8totex_from_char`. */
-                        assert(!"unreachable");
+            const fuzzy_action_t action = fuzzy_step(&fz, *s,
+                options.verbatim);
+            if (action == FUZZY_BAD)
+                ERR(BAD_LITERAL);
+
+            math = action == FUZZY_MATH_TEXT ||
+                   action == FUZZY_MATH_WORD_TEXT;
+            if (action != FUZZY_TEXT && action != FUZZY_WORD_TEXT && !math) {
+                if (stats != NULL)
+                    stats->ascii++;
+                if (action == FUZZY_TEX && fz.state == FUZZY_BRACED &&
+                    is_letter((char)c)) {
+                    /* Hold letters in arguments back like text, so that a
+                     * modifier can apply to them.
+                     */
+                    _lookahead[0] = (char)c;
+                    lookahead = _lookahead;
+                    lookahead_len = 1;
+                    lookahead_flags = 0;
+                } else {
+                    for (int i = 0; i < length; i++)
+                        PUTC(s[i]);
                 }
-                break;
-
-            } case MACRO: {
-
-                assert(fuzzy);
-
-                /* Don't support UTF-8 characters in a macro name. */
-                if (length != 1 || c > 127)
-                    ERR(BAD_LITERAL);
-
-                assert(lookahead == NULL);
-                PUTC(c);
-                if (c == L'{') {
-                    state = BRACED;
-                    assert(brace_depth == 0);
-                    brace_depth = 1;
+                if (action == FUZZY_TEX) {
+                    TRANSLIT_TEX(c);
+                } else if (action == FUZZY_LITERAL && length == 1) {
+                    const char literal = (char)c;
+                    TRANSLIT(&literal, 1);
                 }
+                s += length;
+                continue;
+            }
 
-                break;
+            tex = TEX_TEXT;
+            separate = action == FUZZY_WORD_TEXT ||
+                       action == FUZZY_MATH_WORD_TEXT;
+        }
 
-            } case BRACED: {
+        utf8totex_seq_t t;
+        utf8totex_char_t type;
+        if (options.map != NULL && map_lookup(options.map, c, &t)) {
+            type = UTF8TOTEX_SEQUENCE;
+        } else if (multi != NULL) {
+            /* Look up the character regardless of environment and let
+             * `multi` decide whether the features it needs are
+             * available.
+             */
+            unsigned needs;
+            type = from_char_needs(&t, c, &needs);
+            if (type == UTF8TOTEX_UNSUPPORTED)
+                needs = ~0u;
+            if (needs != 0) {
+                int r = multi_needs(multi, c, needs);
+                if (r == EOF)
+                    ERR(EOF);
+                if (r != 0)
+                    type = UTF8TOTEX_UNSUPPORTED;
+            }
+        } else {
+            type = utf8totex_from_char_ex(&t, c, env);
+        }
 
-                assert(fuzzy);
-                assert(brace_depth > 0);
+        /* There is nothing in math mode for a modifier to apply to. */
+        if (math && type == UTF8TOTEX_MODIFIER)
+            type = UTF8TOTEX_UNSUPPORTED;
+
+        if (stats != NULL) {
+            switch (type) {
+                case UTF8TOTEX_ASCII:       stats->ascii++;       break;
+                case UTF8TOTEX_SEQUENCE:    stats->sequence++;    break;
+                case UTF8TOTEX_MODIFIER:    stats->modifier++;    break;
+                case UTF8TOTEX_UNSUPPORTED:
+                    stats_unsupported(stats, c);
+                    break;
+                case UTF8TOTEX_INVALID:     stats->invalid++;     break;
+                default:                                          break;
+            }
+        }
 
-                if (length != 1)
-                    ERR(BAD_LITERAL);
+        switch (type) {
+            case UTF8TOTEX_ASCII: {
+                const char ascii = (char)c;
+                TRANSLIT(&ascii, 1);
+                /* If a modifier follows, what we output next will
+                 * actually be a '{', but this only matters when `c` is
+                 * a letter and then we are being conservative.
+                 */
+                FLUSH_LOOKAHEAD(c);
+                _lookahead[0] = c;
+                lookahead = _lookahead;
+                lookahead_len = 1;
+                lookahead_flags = 0;
+                break;
+            }
 
-                assert(lookahead == NULL);
-                PUTC(c);
-                if (c == L'{') {
-                    brace_depth++;
-                } else if (c == L'}') {
-                    brace_depth--;
-                    if (brace_depth == 0)
-                        state = IDLE;
+            case UTF8TOTEX_SEQUENCE:
+                TRANSLIT(t.ascii, t.ascii_len);
+                if (math && (t.flags & UTF8TOTEX_SEQ_MATH)) {
+                    /* Already in math mode, so drop the '$'s. */
+                    t.str++;
+                    t.len -= 2;
+                    t.flags &= ~UTF8TOTEX_SEQ_MATH;
+                } else if (math) {
+                    /* Put a text mode sequence back into text mode. */
+                    FLUSH_LOOKAHEAD('\\');
+                    BEGIN_ESCAPE(s);
+                    if (EMIT("\\mbox{", 6) ||
+                        EMIT(t.str, t.len) ||
+                        EMIT_CHAR('}'))
+                        ERR(EOF);
+                    COUNT_OUT(t.len + 7);
+                    END_ESCAPE(s + length);
+                    break;
                 }
-
+                FLUSH_LOOKAHEAD(t.str[0]);
+                if (separate && is_letter(t.str[0])) {
+                    /* End the control word before this, attributing the space
+                     * to it as for a line break.
+                     */
+                    if (srcmap != NULL && in0 + (size_t)(s - base) > srcmap->in) {
+                        BEGIN_ESCAPE(s - 1);
+                        escaped = 1;
+                    }
+                    if (EMIT_CHAR(' '))
+                        ERR(EOF);
+                    COUNT_OUT(1);
+                    END_ESCAPE(s);
+                }
+                lookahead = t.str;
+                lookahead_len = t.len;
+                lookahead_flags = t.flags;
+                lookahead_at = s;
                 break;
 
-            } case MATH: {
-
-                assert(fuzzy);
-
-                if (length != 1)
-                    ERR(BAD_LITERAL);
-
-                assert(lookahead == NULL);
-                PUTC(c);
-                if (c == L'$')
-                    state = IDLE;
+            case UTF8TOTEX_MODIFIER:
+                if (lookahead == NULL || lookahead == _modified)
+                    ERR(BAD_MODIFIER);
+
+                /* Work around older versions of LaTeX that do not know to drop
+                 * overhead dot on an 'i' or 'j' when inserting an accent.
+                 */
+                const bool dotless =
+                  (lookahead[0] == 'i' || lookahead[0] == 'j') &&
+                  (t.flags & UTF8TOTEX_SEQ_DOTLESS);
+
+                /* When eliding braces, a modified ASCII character is
+                 * held back like any other sequence so we can decide
+                 * how to output it once we know what follows.
+                 */
+                if (options.elide_braces != UTF8TOTEX_ELIDE_NONE &&
+                    lookahead == _lookahead &&
+                    t.len + dotless + 2 < sizeof(_modified)) {
+                    char *p = _modified;
+                    memcpy(p, t.str, t.len);
+                    p += t.len;
+                    if (dotless)
+                        *p++ = '\\';
+                    *p++ = _lookahead[0];
+                    *p++ = '}';
+                    *p = '\0';
+                    lookahead = _modified;
+                    lookahead_len = (size_t)(p - _modified);
+                    lookahead_flags = 0;
+                    lookahead_at = s - 1;
+                    break;
+                }
 
+                CLOSE_GROUP();
+                const char *at = lookahead == _lookahead ? s - 1
+                                                         : lookahead_at;
+                WRAP(t.len + dotless + lookahead_len + 1, at);
+                BEGIN_ESCAPE(at);
+                hold = true;
+                if (EMIT(t.str, t.len) ||
+                    (dotless && EMIT_CHAR('\\')))
+                    ERR(EOF);
+                COUNT_OUT(t.len + dotless);
+                FLUSH_LOOKAHEAD('}');
+                PUTC('}');
+                hold = false;
+                END_ESCAPE(s + length);
                 break;
-            }
 
+            case UTF8TOTEX_UNSUPPORTED:
+                TRACE(unsupported, c, (size_t)(s - base));
+                /* fall through */
+            case UTF8TOTEX_INVALID:
+                TRACE(error, type, (size_t)(s - base));
+                if (error != NULL)
+                    *error = type;
+                RETURN(EOF);
+
+            default:
+                /* These are never returned by `utf8totex_from_char_ex`. */
+                assert(!"unreachable");
         }
-
         s += length;
     }
 
-    FLUSH_LOOKAHEAD();
+    /* If we are translating part of a larger string, the caller has
+     * guaranteed that what follows is a plain ASCII character.
+     */
+    FLUSH_LOOKAHEAD(end == NULL ? '\0' : *end);
+    CLOSE_GROUP();
+
+    /* Record any trailing run of unchanged input. */
+    BEGIN_ESCAPE(s);
+
+    if (resume != NULL) {
+        *resume = fz;
+        resume->column = column;
+    }
 
 #undef PUTC
 #undef FLUSH_LOOKAHEAD
+#undef WRAP
+#undef TRANSLIT_TEX
+#undef TRANSLIT
+#undef CLOSE_GROUP
+#undef END_ESCAPE
+#undef BEGIN_ESCAPE
+#undef COUNT_COPIED
+#undef COUNT_OUT
+#undef EMIT_CHAR
+#undef EMIT
 #undef ERR
 
-    return 0;
+    RETURN(0);
+
+#undef RETURN
+#undef TRACE_OUT
+}
+
+int fputs_range(const char *s, const char *end, utf8totex_options_t options,
+        FILE *f, utf8totex_char_t *error, fuzzy_state_t *fuzzy_state) {
+    assert(s != NULL);
+    assert(f != NULL);
+
+    if (options.stats == NULL && options.srcmap == NULL &&
+        options.translit == NULL)
+        return translate(s, end, options, f, NULL, error, fuzzy_state, NULL, NULL,
+            NULL, NULL);
+    if (options.stats == NULL && options.translit == NULL)
+        return translate(s, end, options, f, NULL, error, fuzzy_state, NULL,
+            options.srcmap, NULL, NULL);
+    return translate(s, end, options, f, NULL, error, fuzzy_state, options.stats,
+        options.srcmap, options.translit, NULL);
+}
+
+int fputs_multi(const char *s, utf8totex_options_t options, FILE *f,
+        utf8totex_char_t *error, multi_t *multi) {
+    assert(s != NULL);
+    assert(f != NULL);
+    assert(multi != NULL);
+
+    return translate(s, NULL, options, f, NULL, error, NULL, options.stats,
+        options.srcmap, options.translit, multi);
+}
+
+int fputs_sink(const char *s, utf8totex_options_t options, sink_t *sink,
+        utf8totex_char_t *error) {
+    assert(s != NULL);
+    assert(sink != NULL);
+
+    if (options.stats == NULL && options.srcmap == NULL &&
+        options.translit == NULL)
+        return translate(s, NULL, options, NULL, sink, error, NULL, NULL, NULL,
+            NULL, NULL);
+    return translate(s, NULL, options, NULL, sink, error, NULL, options.stats,
+        options.srcmap, options.translit, NULL);
+}
+
+int utf8totex_fputs_opt(const char *s, utf8totex_options_t options, FILE *f,
+        utf8totex_char_t *error) {
+    return fputs_range(s, NULL, options, f, error, NULL);
 }
@@ -1,25 +1,187 @@
+#include <assert.h>
+#include "internal.h"
+#include <stdalign.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "utf8totex/utf8totex.h"
 #include <wchar.h>
 
 char *utf8totex_from_str(const char *s, bool fuzzy,
         utf8totex_environment_t env, utf8totex_char_t *error) {
+    utf8totex_options_t options = UTF8TOTEX_DEFAULT_OPTIONS;
+    options.fuzzy = fuzzy;
+    options.env = env;
+    return utf8totex_from_str_opt(s, options, error);
+}
+
+char *utf8totex_from_str_opt(const char *s, utf8totex_options_t options,
+        utf8totex_char_t *error) {
+
+    TRACE(from_str_entry, s);
 
     /* setup a dynamically growing buffer */
     char *buffer_p;
     size_t buffer_size;
     FILE *buffer = open_memstream(&buffer_p, &buffer_size);
-    if (buffer == NULL)
+    if (buffer == NULL) {
+        TRACE(error, UTF8TOTEX_EOF, (size_t)0);
+        TRACE(from_str_return, (const char*)NULL, (size_t)0);
         return NULL;
+    }
 
-    int r = utf8totex_fputs(s, fuzzy, env, buffer, error);
+    int r = utf8totex_fputs_opt(s, options, buffer, error);
     fclose(buffer);
     if (r != 0) {
         free(buffer_p);
+        TRACE(from_str_return, (const char*)NULL, (size_t)0);
         return NULL;
     }
 
+    TRACE(from_str_return, buffer_p, buffer_size);
     return buffer_p;
 }
+
+/* Arena allocation. Every allocation is aligned as `malloc` would, so the
+ * arena is usable for more than just our strings. The most recent allocation
+ * can be grown or released in place, which is all a single translation needs.
+ */
+
+static size_t align_up(size_t n) {
+    const size_t a = alignof(max_align_t);
+    return (n + a - 1) / a * a;
+}
+
+static void *arena_alloc(void *user, size_t size) {
+    utf8totex_arena_t *arena = user;
+    size_t start = align_up(arena->used);
+    if (start > arena->size || arena->size - start < size)
+        return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+static bool arena_is_last(const utf8totex_arena_t *arena, const void *p,
+        size_t size) {
+    return (const char*)p + size == arena->base + arena->used;
+}
+
+static void *arena_realloc(void *user, void *p, size_t old_size,
+        size_t new_size) {
+    utf8totex_arena_t *arena = user;
+    if (p == NULL)
+        return arena_alloc(arena, new_size);
+    if (arena_is_last(arena, p, old_size)) {
+        size_t start = (size_t)((char*)p - arena->base);
+        if (arena->size - start < new_size)
+            return NULL;
+        arena->used = start + new_size;
+        return p;
+    }
+    void *q = arena_alloc(arena, new_size);
+    if (q != NULL)
+        memcpy(q, p, old_size < new_size ? old_size : new_size);
+    return q;
+}
+
+static void arena_free(void *user, void *p, size_t size) {
+    utf8totex_arena_t *arena = user;
+    if (p != NULL && arena_is_last(arena, p, size))
+        arena->used = (size_t)((char*)p - arena->base);
+}
+
+utf8totex_allocator_t utf8totex_arena_allocator(utf8totex_arena_t *arena) {
+    return (utf8totex_allocator_t){
+        .alloc = arena_alloc,
+        .realloc = arena_realloc,
+        .free = arena_free,
+        .user = arena,
+    };
+}
+
+/* A sink writing into memory obtained from a `utf8totex_allocator_t`. */
+typedef struct {
+    sink_t sink;
+    const utf8totex_allocator_t *allocator;
+} alloc_sink_t;
+
+static int alloc_grow(sink_t *sink, size_t n) {
+    alloc_sink_t *a = (alloc_sink_t*)sink;
+
+    /* Leave room for a NUL terminator. */
+    size_t size = sink->size == 0 ? 256 : sink->size;
+    while (size - sink->len < n + 1)
+        size *= 2;
+    char *p = a->allocator->realloc(a->allocator->user, sink->buffer,
+        sink->size, size);
+    if (p == NULL)
+        return -1;
+    sink->buffer = p;
+    sink->size = size;
+    return 0;
+}
+
+char *utf8totex_from_str_alloc(const char *s, utf8totex_options_t options,
+        const utf8totex_allocator_t *allocator, utf8totex_char_t *error) {
+    assert(allocator != NULL);
+
+    TRACE(from_str_entry, s);
+
+    /* Output is written straight into the result, so no other memory is
+     * needed.
+     */
+    alloc_sink_t a = { .sink = { .grow = alloc_grow }, .allocator = allocator };
+    sink_t *sink = &a.sink;
+
+    if (fputs_sink(s, options, sink, error) != 0) {
+        if (sink->buffer != NULL)
+            allocator->free(allocator->user, sink->buffer, sink->size);
+        TRACE(from_str_return, (const char*)NULL, (size_t)0);
+        return NULL;
+    }
+
+    /* An empty result. */
+    if (sink->buffer == NULL) {
+        sink->buffer = allocator->alloc(allocator->user, 1);
+        if (sink->buffer == NULL)
+            goto fail;
+        sink->size = 1;
+    }
+    sink->buffer[sink->len] = '\0';
+
+    /* Trim to the size we tell the caller to free with. */
+    if (sink->size > sink->len + 1) {
+        char *p = allocator->realloc(allocator->user, sink->buffer, sink->size,
+            sink->len + 1);
+        if (p == NULL) {
+            allocator->free(allocator->user, sink->buffer, sink->size);
+            goto fail;
+        }
+        sink->buffer = p;
+    }
+
+    TRACE(from_str_return, sink->buffer, sink->len);
+    return sink->buffer;
+
+fail:
+    TRACE(error, UTF8TOTEX_EOF, (size_t)0);
+    TRACE(from_str_return, (const char*)NULL, (size_t)0);
+    if (error != NULL)
+        *error = UTF8TOTEX_EOF;
+    return NULL;
+}
+
+char *utf8totex_from_str_arena(const char *s, utf8totex_options_t options,
+        utf8totex_arena_t *arena, utf8totex_char_t *error) {
+    assert(arena != NULL);
+
+    /* Also undo any padding added for alignment if we fail. */
+    size_t used = arena->used;
+    utf8totex_allocator_t allocator = utf8totex_arena_allocator(arena);
+    char *r = utf8totex_from_str_alloc(s, options, &allocator, error);
+    if (r == NULL)
+        arena->used = used;
+    return r;
+}
@@ -0,0 +1,304 @@
+/* The fuzzy mode state machine.
+ *
+ * In fuzzy mode, the input is assumed to be a mixture of text and TeX. TeX is
+ * recognised by the ASCII characters that drive this state machine and is
+ * passed through, while text, including any text within the arguments of
+ * macros, is translated. Text in math mode, delimited by $...$, $$...$$,
+ * \(...\) or \[...\], is translated for math mode. The exceptions are the
+ * arguments of verbatim-like macros and the bodies of verbatim-like
+ * environments, which are passed through untouched, even where they are not
+ * ASCII.
+ *
+ * This is shared by the translation loop in fputs.c and by the pre-scan that
+ * finds places to cut the input in parallel.c, so both agree on where TeX
+ * begins and ends. The C++ interface in include/utf8totex/utf8totex.hpp has its
+ * own copy, which must be kept in step with any change here.
+ */
+
+#include <assert.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "utf8totex/utf8totex.h"
+
+static const char *const default_verbatim[] = {
+    "\\href", "\\path", "\\url", "\\verb", "comment", "lstlisting", "minted",
+    "Verbatim", "verbatim", "verbatim*", NULL,
+};
+
+static bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* The state to return to at the end of a TeX construct. */
+static unsigned context(const fuzzy_state_t *fz) {
+    return fz->brace_depth > 0 || fz->brackets > 0 ? FUZZY_BRACED : FUZZY_IDLE;
+}
+
+static void name_start(fuzzy_state_t *fz) {
+    memset(fz->name, 0, sizeof(fz->name));
+    fz->name_len = 0;
+}
+
+/* Append to the name being read. A name too long to fit is still counted, so
+ * that it matches nothing.
+ */
+static void name_append(fuzzy_state_t *fz, char c) {
+    if (fz->name_len < sizeof(fz->name) - 1)
+        fz->name[fz->name_len] = c;
+    if (fz->name_len < sizeof(fz->name))
+        fz->name_len++;
+}
+
+static bool name_is(const fuzzy_state_t *fz, const char *name) {
+    size_t len = strlen(name);
+    return fz->name_len == len && memcmp(fz->name, name, len) == 0;
+}
+
+/* Is the name just read a verbatim macro (`macro`) or environment? */
+static bool is_verbatim(const fuzzy_state_t *fz, bool macro,
+        const char *const *verbatim) {
+    if (verbatim == NULL)
+        verbatim = default_verbatim;
+    for (; *verbatim != NULL; verbatim++) {
+        const char *v = *verbatim;
+        if ((v[0] == '\\') == macro && name_is(fz, v + macro))
+            return true;
+    }
+    return false;
+}
+
+/* Enter math mode, to be ended by `delimiter`. */
+static fuzzy_action_t math(fuzzy_state_t *fz, char delimiter,
+        unsigned progress) {
+    fz->delimiter = delimiter;
+    fz->progress = progress;
+    fz->state = FUZZY_MATH;
+    return FUZZY_TEX;
+}
+
+/* The `i`th character of the `\end{...}` closing a verbatim environment. */
+static char end_char(const fuzzy_state_t *fz, unsigned i) {
+    return i < 5 ? "\\end{"[i] : i < 5 + fz->name_len ? fz->name[i - 5] : '}';
+}
+
+fuzzy_action_t fuzzy_step(fuzzy_state_t *fz, char c,
+        const char *const *verbatim) {
+    assert(fz != NULL);
+
+    const bool ascii = (unsigned char)c < 0x80;
+
+    switch (fz->state) {
+
+        case FUZZY_IDLE:
+            if (c == '\\') {
+                name_start(fz);
+                fz->state = FUZZY_MACRO;
+            } else if (c == '{') {
+                assert(fz->brace_depth == 0);
+                fz->brace_depth = 1;
+                fz->state = FUZZY_BRACED;
+            } else if (c == '$') {
+                fz->state = FUZZY_MATH_OPEN;
+            } else {
+                return FUZZY_TEXT;
+            }
+            return FUZZY_TEX;
+
+        case FUZZY_BRACED:
+            if (!ascii)
+                return FUZZY_TEXT;
+            if (c == '\\') {
+                name_start(fz);
+                fz->state = FUZZY_MACRO;
+            } else if (c == '{') {
+                fz->brace_depth++;
+            } else if (c == '$') {
+                fz->state = FUZZY_MATH_OPEN;
+            } else if (c == '}' && fz->brace_depth > 0) {
+                fz->brace_depth--;
+                fz->state = context(fz);
+            } else if (c == ']' && fz->brackets > 0) {
+                fz->brackets--;
+                fz->state = context(fz);
+            }
+            return FUZZY_TEX;
+
+        case FUZZY_MATH_OPEN:
+            if (c == '$')
+                return math(fz, '$', 2);
+            math(fz, '$', 1);
+            return fuzzy_step(fz, c, verbatim);
+
+        case FUZZY_MATH:
+            if (!ascii)
+                return FUZZY_MATH_TEXT;
+            if (c == '\\') {
+                fz->name_len = 0;
+                fz->state = FUZZY_MATH_MACRO;
+            } else if (c == '$' && fz->delimiter == '$') {
+                fz->state = fz->progress == 1 ? context(fz) : FUZZY_MATH_CLOSE;
+            }
+            return FUZZY_TEX;
+
+        case FUZZY_MATH_CLOSE:
+            fz->state = context(fz);
+            if (c == '$')
+                return FUZZY_TEX;
+            return fuzzy_step(fz, c, verbatim);
+
+        case FUZZY_MATH_MACRO:
+            /* Only whether this is a control word matters, not its name. */
+            if (is_letter(c)) {
+                fz->name_len = 1;
+                return FUZZY_TEX;
+            }
+            if (fz->name_len == 0) {
+                if (!ascii)
+                    return FUZZY_BAD;
+                if (c == fz->delimiter && c != '$') {
+                    fz->state = context(fz);
+                } else {
+                    fz->state = FUZZY_MATH;
+                }
+                return FUZZY_TEX;
+            }
+            fz->state = FUZZY_MATH;
+            fuzzy_action_t action = fuzzy_step(fz, c, verbatim);
+            return action == FUZZY_MATH_TEXT ? FUZZY_MATH_WORD_TEXT : action;
+
+        case FUZZY_MACRO:
+            if (is_letter(c)) {
+                name_append(fz, c);
+                return FUZZY_TEX;
+            }
+            if (fz->name_len == 0) {
+                /* A control symbol, of which \( and \[ begin math mode */
+                if (!ascii)
+                    return FUZZY_BAD;
+                if (c == '(')
+                    return math(fz, ')', 1);
+                if (c == '[')
+                    return math(fz, ']', 1);
+                fz->state = FUZZY_ARGS;
+                return FUZZY_TEX;
+            }
+            /* The end of a control word. What follows is looked at afresh. */
+            if (is_verbatim(fz, true, verbatim)) {
+                fz->state = FUZZY_VERB_OPEN;
+            } else if (name_is(fz, "begin")) {
+                fz->state = FUZZY_BEGIN;
+            } else {
+                fz->state = FUZZY_ARGS;
+                fuzzy_action_t action = fuzzy_step(fz, c, verbatim);
+                return action == FUZZY_TEXT ? FUZZY_WORD_TEXT : action;
+            }
+            return fuzzy_step(fz, c, verbatim);
+
+        case FUZZY_ARGS:
+            /* Optional arguments are TeX like braced ones. */
+            if (is_space(c) || c == '*')
+                return FUZZY_TEX;
+            if (c == '[') {
+                fz->brackets++;
+                fz->state = FUZZY_BRACED;
+                return FUZZY_TEX;
+            }
+            fz->state = context(fz);
+            return fuzzy_step(fz, c, verbatim);
+
+        case FUZZY_BEGIN:
+            if (is_space(c))
+                return FUZZY_TEX;
+            if (c == '{') {
+                name_start(fz);
+                fz->state = FUZZY_ENV_NAME;
+                return FUZZY_TEX;
+            }
+            fz->state = context(fz);
+            return fuzzy_step(fz, c, verbatim);
+
+        case FUZZY_ENV_NAME:
+            if (!ascii)
+                return FUZZY_BAD;
+            if (c == '}') {
+                if (is_verbatim(fz, false, verbatim)) {
+                    fz->progress = 0;
+                    fz->state = FUZZY_VERB_ENV;
+                } else {
+                    fz->state = context(fz);
+                }
+            } else {
+                name_append(fz, c);
+            }
+            return FUZZY_TEX;
+
+        case FUZZY_VERB_OPEN:
+            if (!ascii)
+                return FUZZY_BAD;
+            if (is_space(c) || c == '*')
+                return FUZZY_HIDDEN;
+            /* Either a braced argument or one delimited by this character, as
+             * for \verb.
+             */
+            fz->delimiter = c == '{' ? '}' : c;
+            fz->progress = 1;
+            fz->state = FUZZY_VERBATIM;
+            return FUZZY_HIDDEN;
+
+        case FUZZY_VERBATIM:
+            if (fz->delimiter == '}' && c == '{') {
+                fz->progress++;
+            } else if (c == fz->delimiter && --fz->progress == 0) {
+                fz->state = context(fz);
+                return FUZZY_HIDDEN;
+            }
+            return FUZZY_LITERAL;
+
+        case FUZZY_VERB_ENV:
+            if (c == end_char(fz, fz->progress)) {
+                if (++fz->progress == fz->name_len + 6)
+                    fz->state = context(fz);
+            } else {
+                fz->progress = c == '\\';
+            }
+            return FUZZY_HIDDEN;
+    }
+
+    assert(!"unreachable");
+    return FUZZY_BAD;
+}
+
+bool fuzzy_state_equal(const fuzzy_state_t *a, const fuzzy_state_t *b) {
+    assert(a != NULL);
+    assert(b != NULL);
+
+    if (a->state != b->state || a->brace_depth != b->brace_depth ||
+        a->brackets != b->brackets || a->column != b->column)
+        return false;
+
+    switch (a->state) {
+        case FUZZY_MACRO:
+        case FUZZY_ENV_NAME:
+            return a->name_len == b->name_len &&
+                   memcmp(a->name, b->name, sizeof(a->name)) == 0;
+        case FUZZY_VERBATIM:
+            return a->delimiter == b->delimiter && a->progress == b->progress;
+        case FUZZY_VERB_ENV:
+            return a->name_len == b->name_len &&
+                   memcmp(a->name, b->name, sizeof(a->name)) == 0 &&
+                   a->progress == b->progress;
+        case FUZZY_MATH:
+            return a->delimiter == b->delimiter && a->progress == b->progress;
+        case FUZZY_MATH_MACRO:
+            return a->delimiter == b->delimiter &&
+                   a->progress == b->progress && a->name_len == b->name_len;
+        default:
+            return true;
+    }
+}
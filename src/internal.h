@@ -1,5 +1,227 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include "utf8totex/utf8totex.h"
+
+/* Static tracepoints. These are only compiled in when configured with
+ * `-DUTF8TOTEX_TRACE=ON`, in which case they are USDT probes under the provider
+ * "utf8totex" that tools like bpftrace and perf can attach to. When no tool is
+ * attached, a probe costs a single no-op instruction.
+ *
+ *   fputs_entry(const char *s, bool fuzzy)
+ *   fputs_return(int result, size_t bytes_in, size_t bytes_out)
+ *       Around each translation pass. A parallel or incremental translation
+ *       makes one pass per chunk.
+ *   from_str_entry(const char *s)
+ *   from_str_return(const char *result, size_t len)
+ *       Around each translation into memory. `result` is `NULL` on failure.
+ *   error(int code, size_t offset)
+ *       On each failure, with the `utf8totex_char_t` error and the offset of
+ *       the input at which it occurred.
+ *   unsupported(uint32_t code_point, size_t offset)
+ *       On each character that could not be translated.
+ */
+#ifdef UTF8TOTEX_TRACE
+#include <sys/sdt.h>
+#define TRACE(probe, ...) STAP_PROBEV(utf8totex, probe, __VA_ARGS__)
+#else
+#define TRACE(probe, ...) do { } while (0)
+#endif
 
 int get_utf8_char(uint32_t *c, const char *s) __attribute__((visibility("internal")));
+
+/* Compute the `UTF8TOTEX_SEQ_*` flags for a sequence at runtime. `modifier`
+ * indicates whether it was returned as a `UTF8TOTEX_MODIFIER`.
+ */
+unsigned seq_flags(const char *s, size_t len, bool modifier)
+    __attribute__((visibility("internal")));
+
+/* Compute the plain ASCII transliteration of a sequence at runtime, writing it
+ * to `ascii` followed by a NUL terminator and returning its length. Control
+ * sequences are dropped or spelled out, as are braces and math shifts, so this
+ * is never longer than the sequence itself.
+ */
+size_t seq_ascii(const char *s, size_t len, char *ascii)
+    __attribute__((visibility("internal")));
+
+/* Features of an environment that some sequences in the translation table
+ * depend on.
+ */
+enum {
+    NEEDS_T1 = 1 << 0,       /* A T1-compatible font encoding */
+    NEEDS_TEXTCOMP = 1 << 1, /* \usepackage{textcomp} */
+    NEEDS_CYRILLIC = 1 << 2, /* A Cyrillic font encoding, T2A, T2B, T2C, X2 or
+                                OT2 */
+    NEEDS_T2A = 1 << 3,      /* A Cyrillic font encoding with the letters of
+                                the Slavic languages other than Russian, T2A
+                                or X2 */
+    NEEDS_ENCODING = NEEDS_T1 | NEEDS_CYRILLIC | NEEDS_T2A,
+    NEEDS_ALL = NEEDS_ENCODING | NEEDS_TEXTCOMP,
+};
+
+/* The `NEEDS_*` features an environment provides. */
+unsigned env_features(utf8totex_environment_t env)
+    __attribute__((visibility("internal")));
+
+/* As for `utf8totex_from_char_ex`, but ignoring the environment. A sequence is
+ * returned even if only some environments support it, with the features it
+ * requires in `needs`.
+ */
+utf8totex_char_t from_char_needs(utf8totex_seq_t *seq, uint32_t c,
+    unsigned *needs) __attribute__((visibility("internal")));
+
+/* Find the overlay's sequence for `c`, if it has one. `seq` may be `NULL`. */
+bool map_lookup(const utf8totex_map_t *map, uint32_t c, utf8totex_seq_t *seq)
+    __attribute__((visibility("internal")));
+
+/* States of the fuzzy mode state machine. See fuzzy.c. */
+enum {
+    FUZZY_IDLE,      /* In text, outside any TeX */
+    FUZZY_MACRO,     /* Reading the name of a control sequence */
+    FUZZY_BRACED,    /* In a braced or optional argument, where ASCII is TeX
+                        but anything else is translated */
+    FUZZY_MATH,      /* In math mode, where ASCII is TeX but anything else
+                        is translated to math */
+    FUZZY_ARGS,      /* After a control sequence, before any optional
+                        argument */
+    FUZZY_BEGIN,     /* After \begin, before its argument */
+    FUZZY_ENV_NAME,  /* Reading the name of an environment */
+    FUZZY_VERB_OPEN, /* After a verbatim macro, before its argument */
+    FUZZY_VERBATIM,  /* In the argument of a verbatim macro */
+    FUZZY_VERB_ENV,  /* In the body of a verbatim environment */
+    FUZZY_MATH_OPEN, /* After a '$' opening math mode, which may be the first
+                        of two */
+    FUZZY_MATH_MACRO, /* Reading the name of a control sequence in math mode */
+    FUZZY_MATH_CLOSE, /* After the first '$' of two closing display math */
+};
+
+/* State of the fuzzy mode state machine, along with the output column for line
+ * breaking, for translating a string in pieces. All zeroes is the initial
+ * state.
+ */
+typedef struct {
+    unsigned state;
+    unsigned brace_depth;
+    unsigned brackets;   /* Open optional arguments */
+    size_t column;
+
+    /* The name of the control sequence or environment being read, or of the
+     * verbatim environment we are in, NUL padded
+     */
+    char name[32];
+    unsigned name_len;
+
+    /* In a verbatim argument, the character ending it and how many of these
+     * are needed ('}' for a braced argument). In a verbatim environment, how
+     * much of the \end{...} ending it has been seen. In math mode, the
+     * character ending it, ')' and ']' following a backslash, and for '$'
+     * how many are needed.
+     */
+    char delimiter;
+    unsigned progress;
+} fuzzy_state_t;
+
+/* What to do with a character, as decided by `fuzzy_step` */
+typedef enum {
+    FUZZY_TEXT,      /* Translate it */
+    FUZZY_WORD_TEXT, /* Translate it, keeping it from running into the control
+                        word output before it */
+    FUZZY_TEX,       /* Output it as-is */
+    FUZZY_LITERAL,   /* Output it as-is and, if it is ASCII, transliterate it
+                        as-is */
+    FUZZY_HIDDEN,    /* Output it as-is but leave it out of any
+                        transliteration */
+    FUZZY_BAD,       /* It is not ASCII but is somewhere only TeX can be */
+    FUZZY_MATH_TEXT, /* Translate it for math mode */
+    FUZZY_MATH_WORD_TEXT, /* Translate it for math mode, keeping it from running
+                             into the control word output before it */
+} fuzzy_action_t;
+
+/* Advance the fuzzy mode state machine over the next byte of input, `c`. Any
+ * byte of a multibyte character may be given in place of the character itself.
+ * `verbatim` is the list from `utf8totex_options_t`.
+ */
+fuzzy_action_t fuzzy_step(fuzzy_state_t *fz, char c,
+    const char *const *verbatim) __attribute__((visibility("internal")));
+
+/* Whether translation would proceed identically from these states. */
+bool fuzzy_state_equal(const fuzzy_state_t *a, const fuzzy_state_t *b)
+    __attribute__((visibility("internal")));
+
+/* Translate the string `s` up to, but not including, `end`, or up to its NUL
+ * terminator if `end` is `NULL`. If `end` is not `NULL`, it must point at an
+ * ASCII character that will translate to itself and be the start of a token,
+ * such as a space. If `fuzzy_state` is not `NULL`, translation starts in the
+ * state it describes and on success it is updated with the final state.
+ */
+int fputs_range(const char *s, const char *end, utf8totex_options_t options,
+    FILE *f, utf8totex_char_t *error, fuzzy_state_t *fuzzy_state)
+    __attribute__((visibility("internal")));
+
+/* Memory that output can be written straight into, bypassing stdio. When
+ * `buffer` is full, `grow` is called to make room for at least `n` more bytes,
+ * returning non-zero if it cannot.
+ */
+typedef struct sink {
+    char *buffer;
+    size_t len;
+    size_t size;
+    int (*grow)(struct sink *sink, size_t n);
+} sink_t;
+
+/* As for `fputs_range` with `end` and `fuzzy_state` `NULL`, but writing the
+ * output to `sink`.
+ */
+int fputs_sink(const char *s, utf8totex_options_t options, sink_t *sink,
+    utf8totex_char_t *error)
+    __attribute__((visibility("internal")));
+
+/* State of a translation for several environments at once. See multi.c. */
+typedef struct multi multi_t;
+
+/* As for `fputs_range` with `end` and `fuzzy_state` `NULL`, but translating for
+ * the environments described by `multi`. Output is written to `f`.
+ */
+int fputs_multi(const char *s, utf8totex_options_t options, FILE *f,
+    utf8totex_char_t *error, multi_t *multi)
+    __attribute__((visibility("internal")));
+
+/* Record that the character `c` needs the `NEEDS_*` features `needs`, failing
+ * the translation for each environment that lacks them. Returns `0` if the
+ * character can be output, `UTF8TOTEX_UNSUPPORTED` if it cannot or `EOF` on an
+ * output error.
+ */
+int multi_needs(multi_t *multi, uint32_t c, unsigned needs)
+    __attribute__((visibility("internal")));
+
+/* Whether a string can be translated in pieces cut immediately before ASCII
+ * spaces and newlines, as required by `fputs_range`.
+ */
+static inline bool can_cut_at_spaces(utf8totex_options_t options) {
+    return options.map == NULL ||
+           (!map_lookup(options.map, ' ', NULL) &&
+            !map_lookup(options.map, '\n', NULL));
+}
+
+void stats_unsupported(utf8totex_stats_t *stats, uint32_t c)
+    __attribute__((visibility("internal")));
+
+struct utf8totex_srcmap {
+    utf8totex_srcmap_entry_t *entries;
+    size_t len;
+    size_t size;
+
+    /* End of the last entry in the input and output. */
+    size_t in;
+    size_t out;
+};
+
+/* Record that everything up to `in` in the input has produced everything up to
+ * `out` in the output. `identity` indicates the new input was copied through
+ * unchanged.
+ */
+int srcmap_sync(utf8totex_srcmap_t *m, size_t in, size_t out, bool identity)
+    __attribute__((visibility("internal")));
@@ -0,0 +1,254 @@
+/* User mapping overlays.
+ *
+ * A mapping file provides replacement escape sequences for individual code
+ * points, consulted before the built-in table in from_char.c. The format is
+ * line-based:
+ *
+ *     # Comments start with a hash.
+ *     U+0126 {\textHbar}
+ *     “      ``
+ *
+ * Each line gives a code point, either in U+XXXX notation or as a literal UTF-8
+ * character, followed by whitespace and the ASCII TeX to emit for it. Later
+ * lines override earlier ones. The transliteration of each character is
+ * derived from its TeX.
+ *
+ * Once loaded, a map is never modified, so a single instance can be shared
+ * between any number of threads without synchronisation.
+ */
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utf8totex/utf8totex.h"
+
+/* Marker for an unused slot. This is not a valid code point, so cannot clash
+ * with a real key.
+ */
+#define EMPTY UINT32_MAX
+
+struct utf8totex_map {
+    /* Open-addressed hash table with linear probing. `mask` is one less than
+     * the number of slots, which is always a power of two.
+     */
+    struct {
+        uint32_t key;
+        uint32_t offset;    /* into `strings` */
+        uint32_t len;
+        uint32_t flags;     /* `UTF8TOTEX_SEQ_*` */
+        uint32_t ascii_len; /* of the transliteration following the string */
+    } *slots;
+    uint32_t mask;
+    unsigned bits;
+
+    /* All replacement strings, each NUL-terminated and followed by its
+     * NUL-terminated transliteration, laid end-to-end.
+     */
+    char *strings;
+};
+
+static uint32_t hash(uint32_t c, unsigned bits) {
+    /* Fibonacci hashing; code points are dense in places, so a multiplicative
+     * hash spreads neighbouring characters apart.
+     */
+    return (uint32_t)(c * UINT32_C(2654435769)) >> (32 - bits);
+}
+
+bool map_lookup(const utf8totex_map_t *map, uint32_t c, utf8totex_seq_t *seq) {
+    assert(map != NULL);
+
+    for (uint32_t i = hash(c, map->bits); ; i = (i + 1) & map->mask) {
+        if (map->slots[i].key == c) {
+            if (seq != NULL) {
+                seq->str = map->strings + map->slots[i].offset;
+                seq->len = map->slots[i].len;
+                seq->flags = map->slots[i].flags;
+                seq->ascii = seq->str + seq->len + 1;
+                seq->ascii_len = map->slots[i].ascii_len;
+            }
+            return true;
+        }
+        if (map->slots[i].key == EMPTY)
+            return false;
+    }
+}
+
+bool utf8totex_map_lookup(const utf8totex_map_t *map, uint32_t c,
+        utf8totex_seq_t *seq) {
+    return map_lookup(map, c, seq);
+}
+
+/* Can `c` come out of valid UTF-8? */
+static bool is_scalar_value(unsigned long c) {
+    return c < 0x110000 && (c < 0xd800 || c > 0xdfff);
+}
+
+static int parse_code_point(uint32_t *c, const char **s) {
+    if (strncmp(*s, "U+", 2) == 0 || strncmp(*s, "u+", 2) == 0) {
+        char *end;
+        errno = 0;
+        unsigned long v = strtoul(*s + 2, &end, 16);
+        if (errno != 0 || end == *s + 2 || !is_scalar_value(v))
+            return -1;
+        *c = (uint32_t)v;
+        *s = end;
+        return 0;
+    }
+
+    int length = get_utf8_char(c, *s);
+    if (length <= 0 || !is_scalar_value(*c))
+        return -1;
+    *s += length;
+    return 0;
+}
+
+utf8totex_map_t *utf8totex_map_load(const char *path, unsigned *error_line) {
+    assert(path != NULL);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return NULL;
+
+    /* Parsed entries, before they are placed in the hash table. */
+    struct {
+        uint32_t key;
+        uint32_t offset;
+        uint32_t len;
+        uint32_t ascii_len;
+    } *entries = NULL;
+    size_t entries_len = 0;
+    size_t entries_size = 0;
+
+    char *strings = NULL;
+    size_t strings_len = 0;
+    size_t strings_size = 0;
+
+    utf8totex_map_t *map = NULL;
+
+    char *line = NULL;
+    size_t n;
+    unsigned lineno = 0;
+    while (getline(&line, &n, f) != -1) {
+        lineno++;
+
+        const char *s = line;
+        while (isspace((unsigned char)*s))
+            s++;
+        if (*s == '\0' || *s == '#')
+            continue;
+
+        uint32_t c;
+        if (parse_code_point(&c, &s) != 0 || !isspace((unsigned char)*s))
+            goto parse_error;
+        while (isspace((unsigned char)*s))
+            s++;
+
+        size_t len = strlen(s);
+        while (len > 0 && isspace((unsigned char)s[len - 1]))
+            len--;
+        if (len == 0)
+            goto parse_error;
+        for (size_t i = 0; i < len; i++) {
+            /* Output must be ASCII. */
+            if ((unsigned char)s[i] < ' ' || (unsigned char)s[i] > '~')
+                goto parse_error;
+        }
+
+        if (entries_len == entries_size) {
+            size_t size = entries_size == 0 ? 64 : entries_size * 2;
+            void *p = realloc(entries, size * sizeof(entries[0]));
+            if (p == NULL)
+                goto fail;
+            entries = p;
+            entries_size = size;
+        }
+        /* The transliteration is never longer than the string. */
+        if (strings_len + 2 * (len + 1) > strings_size) {
+            size_t size = strings_size == 0 ? 1024 : strings_size;
+            while (strings_len + 2 * (len + 1) > size)
+                size *= 2;
+            char *p = realloc(strings, size);
+            if (p == NULL)
+                goto fail;
+            strings = p;
+            strings_size = size;
+        }
+
+        entries[entries_len].key = c;
+        entries[entries_len].offset = (uint32_t)strings_len;
+        entries[entries_len].len = (uint32_t)len;
+        memcpy(strings + strings_len, s, len);
+        strings[strings_len + len] = '\0';
+        size_t ascii_len = seq_ascii(s, len, strings + strings_len + len + 1);
+        entries[entries_len].ascii_len = (uint32_t)ascii_len;
+        entries_len++;
+        strings_len += len + 1 + ascii_len + 1;
+    }
+    if (ferror(f))
+        goto fail;
+
+    map = calloc(1, sizeof(*map));
+    if (map == NULL)
+        goto fail;
+
+    /* Keep the load factor at or below one half. */
+    map->bits = 4;
+    while (((size_t)1 << map->bits) < entries_len * 2)
+        map->bits++;
+    map->mask = ((uint32_t)1 << map->bits) - 1;
+    map->slots = malloc(((size_t)map->mask + 1) * sizeof(map->slots[0]));
+    if (map->slots == NULL)
+        goto fail;
+    for (uint32_t i = 0; i <= map->mask; i++)
+        map->slots[i].key = EMPTY;
+
+    for (size_t j = 0; j < entries_len; j++) {
+        uint32_t i = hash(entries[j].key, map->bits);
+        while (map->slots[i].key != EMPTY &&
+               map->slots[i].key != entries[j].key)
+            i = (i + 1) & map->mask;
+        map->slots[i].key = entries[j].key;
+        map->slots[i].offset = entries[j].offset;
+        map->slots[i].len = entries[j].len;
+        map->slots[i].ascii_len = entries[j].ascii_len;
+        map->slots[i].flags = seq_flags(strings + entries[j].offset,
+            entries[j].len, false);
+    }
+
+    map->strings = strings;
+    free(entries);
+    free(line);
+    fclose(f);
+    return map;
+
+parse_error:
+    if (error_line != NULL)
+        *error_line = lineno;
+    errno = EINVAL;
+fail:;
+    int err = errno;
+    if (map != NULL)
+        free(map->slots);
+    free(map);
+    free(strings);
+    free(entries);
+    free(line);
+    fclose(f);
+    errno = err;
+    return NULL;
+}
+
+void utf8totex_map_free(utf8totex_map_t *map) {
+    if (map == NULL)
+        return;
+    free(map->slots);
+    free(map->strings);
+    free(map);
+}
@@ -0,0 +1,169 @@
+/* Translation for several environments at once, and for whichever environment
+ * turns out to be needed.
+ *
+ * Environments only affect translation through the sequences in the table that
+ * need particular features (see `env_features`), and an environment either has
+ * such a sequence or has nothing at all for that character. So every
+ * environment that has not yet met a character it does not support would
+ * produce the same output. We translate once as if for an environment with
+ * every feature and write the result through a tee to all the targets still
+ * going. When a character needs a feature some target lacks, that target is
+ * dropped at exactly the point where its own translation would have failed.
+ *
+ * Automatic selection is the same pass with no targets, writing directly to
+ * the caller's file, and noting which features were used along the way.
+ */
+
+#define _GNU_SOURCE /* fopencookie */
+
+#include <assert.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "utf8totex/utf8totex.h"
+
+struct multi {
+    utf8totex_target_t *targets;
+    size_t n;
+
+    /* The stream translation is written to. */
+    FILE *tee;
+
+    /* `NEEDS_*` features that may be used and those that have been. */
+    unsigned features;
+    unsigned needed;
+};
+
+static ssize_t tee_write(void *cookie, const char *buf, size_t size) {
+    multi_t *m = cookie;
+
+    /* A target we fail to write to is dropped, but the others carry on. */
+    for (size_t i = 0; i < m->n; i++) {
+        utf8totex_target_t *t = &m->targets[i];
+        if (t->result == 0 && fwrite(buf, 1, size, t->f) != size) {
+            t->result = EOF;
+            t->error = UTF8TOTEX_EOF;
+        }
+    }
+    return (ssize_t)size;
+}
+
+int multi_needs(multi_t *m, uint32_t c, unsigned needs) {
+    assert(m != NULL);
+
+    bool flushed = false;
+    for (size_t i = 0; i < m->n; i++) {
+        utf8totex_target_t *t = &m->targets[i];
+        if ((needs & ~env_features(t->env)) == 0)
+            continue;
+
+        if (t->stats != NULL)
+            stats_unsupported(t->stats, c);
+        if (t->result != 0)
+            continue;
+
+        /* The target gets everything output up to this point, as it would
+         * have before failing on its own.
+         */
+        if (!flushed) {
+            if (fflush(m->tee) != 0)
+                return EOF;
+            flushed = true;
+        }
+        t->result = EOF;
+        t->error = UTF8TOTEX_UNSUPPORTED;
+    }
+
+    if ((needs & ~m->features) != 0)
+        return UTF8TOTEX_UNSUPPORTED;
+    m->needed |= needs;
+    return 0;
+}
+
+int utf8totex_fputs_multi(const char *s, utf8totex_options_t options,
+        utf8totex_target_t *targets, size_t n) {
+    assert(s != NULL);
+    assert(targets != NULL || n == 0);
+
+    for (size_t i = 0; i < n; i++) {
+        assert(targets[i].f != NULL);
+        targets[i].result = 0;
+    }
+
+    multi_t m = { .targets = targets, .n = n, .features = NEEDS_ALL };
+    m.tee = fopencookie(&m, "w", (cookie_io_functions_t){ .write = tee_write });
+    if (m.tee == NULL) {
+        for (size_t i = 0; i < n; i++) {
+            targets[i].result = EOF;
+            targets[i].error = UTF8TOTEX_EOF;
+        }
+        return EOF;
+    }
+
+    utf8totex_char_t error = UTF8TOTEX_EOF;
+    int r = fputs_multi(s, options, m.tee, &error, &m);
+    if (fclose(m.tee) != 0 && r == 0) {
+        r = EOF;
+        error = UTF8TOTEX_EOF;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (targets[i].result == 0 && r != 0) {
+            targets[i].result = r;
+            targets[i].error = error;
+        }
+        if (targets[i].result != 0)
+            result = EOF;
+    }
+    return result;
+}
+
+int utf8totex_fputs_auto(const char *s, utf8totex_options_t options, FILE *f,
+        utf8totex_environment_t *required, utf8totex_char_t *error) {
+    assert(s != NULL);
+    assert(f != NULL);
+    assert(required != NULL);
+
+    multi_t m = { .tee = f, .features = env_features(options.env) };
+    int r = fputs_multi(s, options, f, error, &m);
+
+    /* Record what was needed even on failure, as the output up to that point
+     * needs it.
+     */
+    if ((m.needed & ~env_features(*required)) != 0) {
+        if (m.needed & NEEDS_ENCODING)
+            required->font_encoding = options.env.font_encoding;
+        if (m.needed & NEEDS_TEXTCOMP)
+            required->textcomp = true;
+    }
+    return r;
+}
+
+int utf8totex_fputs_preamble(utf8totex_environment_t env, FILE *f) {
+    assert(f != NULL);
+
+    static const char *const names[] = {
+        [UTF8TOTEX_FE_OT1] = "OT1", [UTF8TOTEX_FE_OT2] = "OT2",
+        [UTF8TOTEX_FE_OT3] = "OT3", [UTF8TOTEX_FE_OT4] = "OT4",
+        [UTF8TOTEX_FE_OT6] = "OT6", [UTF8TOTEX_FE_T1] = "T1",
+        [UTF8TOTEX_FE_T2A] = "T2A", [UTF8TOTEX_FE_T2B] = "T2B",
+        [UTF8TOTEX_FE_T2C] = "T2C", [UTF8TOTEX_FE_T3] = "T3",
+        [UTF8TOTEX_FE_T4] = "T4", [UTF8TOTEX_FE_T5] = "T5",
+        [UTF8TOTEX_FE_TS1] = "TS1", [UTF8TOTEX_FE_TS3] = "TS3",
+        [UTF8TOTEX_FE_X2] = "X2", [UTF8TOTEX_FE_OML] = "OML",
+        [UTF8TOTEX_FE_OMS] = "OMS", [UTF8TOTEX_FE_OMX] = "OMX",
+    };
+
+    /* OT1 is LaTeX's default and needs nothing. */
+    if (env.font_encoding != UTF8TOTEX_FE_OT1 &&
+        fprintf(f, "\\usepackage[%s]{fontenc}\n",
+                names[env.font_encoding]) < 0)
+        return EOF;
+    if (env.textcomp && fputs("\\usepackage{textcomp}\n", f) == EOF)
+        return EOF;
+    return 0;
+}
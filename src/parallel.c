@@ -0,0 +1,385 @@
+/* Parallel translation of a single large string.
+ *
+ * The input is cut into one chunk per thread and each chunk is translated into
+ * its own memory buffer, after which the buffers are written out in order.
+ * Translation carries very little state from one character to the next, so by
+ * choosing the cut points carefully the chunks can be translated completely
+ * independently and the result is identical to a sequential translation:
+ *
+ *   * Every chunk after the first starts with an ASCII space or newline. These
+ *     translate to themselves, so the lookahead token at the end of the
+ *     previous chunk is flushed exactly as it would have been sequentially, and
+ *     a modifier can never be the first thing in a chunk.
+ *   * In fuzzy mode, a cut is only made where the state machine in fuzzy.c
+ *     would be idle. These points are found by a pre-scan running the same
+ *     state machine over the input bytes. The characters that drive it are all
+ *     ASCII and no byte of a multibyte UTF-8 character is ASCII, so this needs
+ *     no decoding.
+ *
+ * When breaking long lines, where the breaks go also depends on the output
+ * column, which is not known until the previous chunk is done. Each chunk after
+ * the first is translated as if it started a line, in pieces that record the
+ * state at each cut as document.c does. Once the previous chunk is done, if it
+ * did not end at column 0, the start of the chunk is translated again from the
+ * real column until its state matches one recorded along the way. The two
+ * translations agree from there on. This always happens by the first newline
+ * in the chunk, but without one it can take most of the chunk.
+ *
+ * Any transliteration is likewise written to a buffer per chunk.
+ */
+
+#include <assert.h>
+#include "internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "utf8totex/utf8totex.h"
+
+/* Inputs smaller than this are not worth the overhead of starting threads. */
+#define MIN_CHUNK (256 * 1024)
+
+/* Approximate spacing in bytes of input of the points within a chunk at which
+ * its translation can be checked when breaking long lines.
+ */
+#define INTERVAL 4096
+
+/* State at a cut within a chunk, with offsets relative to the chunk's input and
+ * output.
+ */
+typedef struct {
+    size_t in;
+    size_t out;
+    fuzzy_state_t fuzzy;
+} checkpoint_t;
+
+typedef struct {
+    /* Input range */
+    const char *start;
+    size_t len;
+    bool last;
+
+    /* Translated before the output column it starts at is known? */
+    bool speculative;
+
+    utf8totex_options_t options;
+    utf8totex_stats_t stats;
+
+    /* State at the end and, if translated in pieces, at each cut between
+     * them
+     */
+    fuzzy_state_t fuzzy;
+    checkpoint_t *checkpoints;
+    size_t checkpoints_len;
+
+    /* Output. If the start of the chunk was translated again, its output is
+     * `head` followed by `buffer` from `skip` onwards.
+     */
+    char *buffer;
+    size_t size;
+    char *head;
+    size_t head_size;
+    size_t skip;
+    char *translit;
+    size_t translit_size;
+    int result;
+    utf8totex_char_t error;
+} chunk_t;
+
+static bool is_cut(char c) {
+    return c == ' ' || c == '\n';
+}
+
+/* Translate the input of `chunk` from offset `at` to offset `stop`, the end of
+ * the chunk or a cut within it, starting in state `*fuzzy`.
+ */
+static int translate_range(const chunk_t *chunk, size_t at, size_t stop,
+        utf8totex_options_t options, fuzzy_state_t *fuzzy, FILE *f,
+        utf8totex_char_t *error) {
+    const char *end = stop == chunk->len && chunk->last ? NULL
+                                                       : chunk->start + stop;
+    return fputs_range(chunk->start + at, end, options, f, error, fuzzy);
+}
+
+/* Translate `chunk` in pieces of about `INTERVAL` bytes, recording a checkpoint
+ * at each cut between them.
+ */
+static int translate_pieces(chunk_t *chunk, FILE *f) {
+    chunk->checkpoints = malloc((chunk->len / INTERVAL + 1) *
+        sizeof(chunk->checkpoints[0]));
+    if (chunk->checkpoints == NULL) {
+        chunk->error = UTF8TOTEX_EOF;
+        return EOF;
+    }
+
+    for (size_t at = 0; ; ) {
+        size_t cut = chunk->len;
+        if (chunk->len - at > INTERVAL) {
+            cut = at + INTERVAL;
+            while (cut < chunk->len && !is_cut(chunk->start[cut]))
+                cut++;
+        }
+
+        if (translate_range(chunk, at, cut, chunk->options, &chunk->fuzzy, f,
+                            &chunk->error) != 0)
+            return EOF;
+        if (cut == chunk->len)
+            return 0;
+
+        off_t out = ftello(f);
+        if (out == (off_t)-1) {
+            chunk->error = UTF8TOTEX_EOF;
+            return EOF;
+        }
+        chunk->checkpoints[chunk->checkpoints_len++] =
+            (checkpoint_t){ cut, (size_t)out, chunk->fuzzy };
+        at = cut;
+    }
+}
+
+static void *translate_chunk(void *arg) {
+    chunk_t *chunk = arg;
+
+    FILE *f = open_memstream(&chunk->buffer, &chunk->size);
+    if (f == NULL) {
+        chunk->result = EOF;
+        chunk->error = UTF8TOTEX_EOF;
+        return NULL;
+    }
+
+    if (chunk->options.translit != NULL) {
+        chunk->options.translit = open_memstream(&chunk->translit,
+            &chunk->translit_size);
+        if (chunk->options.translit == NULL) {
+            fclose(f);
+            chunk->result = EOF;
+            chunk->error = UTF8TOTEX_EOF;
+            return NULL;
+        }
+    }
+
+    if (chunk->speculative) {
+        chunk->result = translate_pieces(chunk, f);
+    } else {
+        chunk->result = translate_range(chunk, 0, chunk->len, chunk->options,
+            &chunk->fuzzy, f, &chunk->error);
+    }
+    if (fclose(f) != 0 && chunk->result == 0) {
+        chunk->result = EOF;
+        chunk->error = UTF8TOTEX_EOF;
+    }
+    if (chunk->options.translit != NULL &&
+        fclose(chunk->options.translit) != 0 && chunk->result == 0) {
+        chunk->result = EOF;
+        chunk->error = UTF8TOTEX_EOF;
+    }
+    return NULL;
+}
+
+/* Translate the start of `chunk` again, now that we know it starts at output
+ * column `column`, until its state matches one of its checkpoints.
+ */
+static void resync(chunk_t *chunk, size_t column) {
+    /* The transliteration has no line breaks and the statistics only count
+     * them as output, so neither is affected.
+     */
+    utf8totex_options_t options = chunk->options;
+    options.stats = NULL;
+    options.translit = NULL;
+
+    FILE *f = open_memstream(&chunk->head, &chunk->head_size);
+    if (f == NULL) {
+        chunk->result = EOF;
+        chunk->error = UTF8TOTEX_EOF;
+        return;
+    }
+
+    fuzzy_state_t fuzzy = { .column = column };
+    int result = 0;
+    size_t at = 0;
+    size_t k = 0;
+    for (;;) {
+        size_t stop = k < chunk->checkpoints_len ? chunk->checkpoints[k].in
+                                                 : chunk->len;
+        if (translate_range(chunk, at, stop, options, &fuzzy, f,
+                            &chunk->error) != 0) {
+            result = EOF;
+            break;
+        }
+        if (k == chunk->checkpoints_len)
+            break;
+        if (fuzzy_state_equal(&fuzzy, &chunk->checkpoints[k].fuzzy))
+            break;
+        at = stop;
+        k++;
+    }
+    if (fclose(f) != 0 && result == 0) {
+        result = EOF;
+        chunk->error = UTF8TOTEX_EOF;
+    }
+
+    /* If we never matched, we have translated the whole chunk again. */
+    const bool matched = result == 0 && k < chunk->checkpoints_len;
+    chunk->skip = matched ? chunk->checkpoints[k].out : chunk->size;
+    chunk->stats.bytes_out = chunk->stats.bytes_out - chunk->skip +
+        chunk->head_size;
+    if (!matched) {
+        chunk->result = result;
+        chunk->fuzzy = fuzzy;
+    }
+}
+
+/* Find cut points in a non-fuzzy input. `cuts` has `n + 1` entries, the first
+ * and last of which are already set to the start and end of the input.
+ */
+static void find_cuts(const char **cuts, size_t n) {
+    size_t len = (size_t)(cuts[n] - cuts[0]);
+    for (size_t i = 1; i < n; i++) {
+        const char *p = cuts[0] + len / n * i;
+        if (p < cuts[i - 1])
+            p = cuts[i - 1];
+        while (p < cuts[n] && !is_cut(*p))
+            p++;
+        cuts[i] = p;
+    }
+}
+
+/* As for `find_cuts`, but only cutting where the fuzzy state machine would be
+ * idle.
+ */
+static void find_fuzzy_cuts(const char **cuts, size_t n,
+        const char *const *verbatim) {
+    size_t len = (size_t)(cuts[n] - cuts[0]);
+    fuzzy_state_t fz = { 0 };
+    size_t i = 1;
+    for (const char *p = cuts[0]; p < cuts[n] && i < n; p++) {
+        if (fz.state == FUZZY_IDLE && is_cut(*p) &&
+            p >= cuts[0] + len / n * i) {
+            cuts[i++] = p;
+            continue;
+        }
+        (void)fuzzy_step(&fz, *p, verbatim);
+    }
+    for (; i < n; i++)
+        cuts[i] = cuts[n];
+}
+
+int utf8totex_fputs_parallel(const char *s, utf8totex_options_t options,
+        unsigned threads, FILE *f, utf8totex_char_t *error) {
+    assert(s != NULL);
+    assert(f != NULL);
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+
+    size_t len = strlen(s);
+    if (threads > len / MIN_CHUNK)
+        threads = (unsigned)(len / MIN_CHUNK);
+
+    /* A mapping overlay for the characters we cut at would invalidate the
+     * reasoning above.
+     */
+    if (!can_cut_at_spaces(options))
+        threads = 1;
+
+    /* Chunks would need to extend the source map in order. */
+    if (options.srcmap != NULL)
+        threads = 1;
+
+    if (threads <= 1)
+        return utf8totex_fputs_opt(s, options, f, error);
+
+    const char **cuts = malloc((threads + 1) * sizeof(cuts[0]));
+    chunk_t *chunks = calloc(threads, sizeof(chunks[0]));
+    pthread_t *tids = malloc(threads * sizeof(tids[0]));
+    if (cuts == NULL || chunks == NULL || tids == NULL) {
+        free(tids);
+        free(chunks);
+        free(cuts);
+        return utf8totex_fputs_opt(s, options, f, error);
+    }
+
+    cuts[0] = s;
+    cuts[threads] = s + len;
+    if (options.fuzzy) {
+        find_fuzzy_cuts(cuts, threads, options.verbatim);
+    } else {
+        find_cuts(cuts, threads);
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        chunks[i].start = cuts[i];
+        chunks[i].len = (size_t)(cuts[i + 1] - cuts[i]);
+        /* Let the final chunk run up to the NUL terminator. */
+        chunks[i].last = i + 1 == threads;
+        /* A chunk starting with a newline starts at column 0 regardless. */
+        chunks[i].speculative = options.line_limit != 0 && i > 0 &&
+            cuts[i][0] != '\n';
+        chunks[i].options = options;
+        if (options.stats != NULL)
+            chunks[i].options.stats = &chunks[i].stats;
+    }
+
+    /* Translate the first chunk on this thread. If we fail to start a thread,
+     * translate its chunk here too.
+     */
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, translate_chunk, &chunks[i]) != 0) {
+            translate_chunk(&chunks[i]);
+            tids[i] = pthread_self();
+        }
+    }
+    translate_chunk(&chunks[0]);
+
+    int result = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        if (i > 0 && !pthread_equal(tids[i], pthread_self()))
+            pthread_join(tids[i], NULL);
+
+        if (result == 0 && chunks[i].speculative &&
+            chunks[i - 1].fuzzy.column != 0)
+            resync(&chunks[i], chunks[i - 1].fuzzy.column);
+
+        /* Write out and count everything up to and including the first failed
+         * chunk, to mimic how far a sequential translation would have got.
+         */
+        if (result == 0) {
+            if (options.stats != NULL)
+                utf8totex_stats_merge(options.stats, &chunks[i].stats);
+            size_t size = chunks[i].size - chunks[i].skip;
+            if ((chunks[i].head_size > 0 &&
+                 fwrite(chunks[i].head, 1, chunks[i].head_size, f) !=
+                   chunks[i].head_size) ||
+                (size > 0 &&
+                 fwrite(chunks[i].buffer + chunks[i].skip, 1, size, f) !=
+                   size) ||
+                (chunks[i].translit_size > 0 &&
+                 fwrite(chunks[i].translit, 1, chunks[i].translit_size,
+                   options.translit) != chunks[i].translit_size)) {
+                result = EOF;
+                if (error != NULL)
+                    *error = UTF8TOTEX_EOF;
+            } else if (chunks[i].result != 0) {
+                result = chunks[i].result;
+                if (error != NULL)
+                    *error = chunks[i].error;
+            }
+        }
+
+        free(chunks[i].translit);
+        free(chunks[i].head);
+        free(chunks[i].buffer);
+        free(chunks[i].checkpoints);
+    }
+
+    free(tids);
+    free(chunks);
+    free(cuts);
+    return result;
+}
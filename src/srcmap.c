@@ -0,0 +1,144 @@
+/* Source maps.
+ *
+ * A source map is a sorted array of entries that each pair a range of input
+ * with the range of output it produced. Runs of ASCII that were copied through
+ * unchanged share a single entry, so for typical input the map is far smaller
+ * than either the input or the output. Both the input and output offsets
+ * increase monotonically through the array, so a lookup in either direction is
+ * a binary search.
+ */
+
+#include <assert.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "utf8totex/utf8totex.h"
+
+utf8totex_srcmap_t *utf8totex_srcmap_new(void) {
+    return calloc(1, sizeof(utf8totex_srcmap_t));
+}
+
+void utf8totex_srcmap_free(utf8totex_srcmap_t *m) {
+    if (m == NULL)
+        return;
+    free(m->entries);
+    free(m);
+}
+
+const utf8totex_srcmap_entry_t *utf8totex_srcmap_entries(
+        const utf8totex_srcmap_t *m, size_t *len) {
+    *len = m->len;
+    return m->entries;
+}
+
+int srcmap_sync(utf8totex_srcmap_t *m, size_t in, size_t out, bool identity) {
+    assert(m != NULL);
+    assert(in >= m->in);
+    assert(out >= m->out);
+
+    if (in == m->in && out == m->out)
+        return 0;
+
+    identity = identity && in - m->in == out - m->out;
+
+    /* Extend a preceding run of unchanged input. */
+    if (identity && m->len > 0 && m->entries[m->len - 1].identity &&
+        m->entries[m->len - 1].in_len <= UINT32_MAX - (in - m->in)) {
+        m->entries[m->len - 1].in_len += (uint32_t)(in - m->in);
+        m->entries[m->len - 1].out_len += (uint32_t)(out - m->out);
+        m->in = in;
+        m->out = out;
+        return 0;
+    }
+
+    /* Output with no input of its own (e.g. the closing '$' of a math group)
+     * or input that produced no output belongs to whatever came before it.
+     */
+    if ((in == m->in || out == m->out) && m->len > 0) {
+        utf8totex_srcmap_entry_t *e = &m->entries[m->len - 1];
+        assert(e->in_len <= UINT32_MAX - (in - m->in));
+        assert(e->out_len <= UINT32_MAX - (out - m->out));
+        e->in_len += (uint32_t)(in - m->in);
+        e->out_len += (uint32_t)(out - m->out);
+        e->identity = false;
+        m->in = in;
+        m->out = out;
+        return 0;
+    }
+
+    if (m->len == m->size) {
+        size_t size = m->size == 0 ? 256 : m->size * 2;
+        utf8totex_srcmap_entry_t *p = realloc(m->entries,
+            size * sizeof(m->entries[0]));
+        if (p == NULL)
+            return -1;
+        m->entries = p;
+        m->size = size;
+    }
+
+    assert(in - m->in <= UINT32_MAX);
+    assert(out - m->out <= UINT32_MAX);
+    m->entries[m->len++] = (utf8totex_srcmap_entry_t){
+        .in = m->in,
+        .out = m->out,
+        .in_len = (uint32_t)(in - m->in),
+        .out_len = (uint32_t)(out - m->out),
+        .identity = identity,
+    };
+    m->in = in;
+    m->out = out;
+    return 0;
+}
+
+/* Narrow the entry containing `offset` to the ranges that correspond to it. */
+static void narrow(const utf8totex_srcmap_entry_t *e, size_t delta,
+        utf8totex_srcmap_entry_t *range) {
+    *range = *e;
+    if (e->identity) {
+        range->in += delta;
+        range->out += delta;
+        range->in_len = 1;
+        range->out_len = 1;
+    }
+}
+
+int utf8totex_srcmap_to_output(const utf8totex_srcmap_t *m, size_t offset,
+        utf8totex_srcmap_entry_t *range) {
+    if (offset >= m->in)
+        return -1;
+
+    /* Find the last entry starting at or before `offset`. */
+    size_t lo = 0, hi = m->len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (m->entries[mid].in <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    narrow(&m->entries[lo], offset - m->entries[lo].in, range);
+    return 0;
+}
+
+int utf8totex_srcmap_to_input(const utf8totex_srcmap_t *m, size_t offset,
+        utf8totex_srcmap_entry_t *range) {
+    if (offset >= m->out)
+        return -1;
+
+    size_t lo = 0, hi = m->len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (m->entries[mid].out <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    narrow(&m->entries[lo], offset - m->entries[lo].out, range);
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* Translation statistics.
+ *
+ * The histogram of unsupported code points uses the "Space-Saving" algorithm
+ * of Metwally, Agrawal and El Abbadi: a fixed number of counters, where a new
+ * code point that finds no free counter evicts the smallest one and inherits
+ * its count. Frequent code points are guaranteed to be retained, which is all
+ * we need to find out what is making documents fail.
+ */
+
+#include <assert.h>
+#include "internal.h"
+#include <stddef.h>
+#include <stdint.h>
+#include "utf8totex/utf8totex.h"
+
+static void add_unsupported(utf8totex_stats_t *stats, uint32_t c,
+        uint64_t count) {
+
+    size_t smallest = 0;
+    for (size_t i = 0; i < UTF8TOTEX_STATS_TOP; i++) {
+        if (stats->top_unsupported[i].count == 0 ||
+            stats->top_unsupported[i].code_point == c) {
+            stats->top_unsupported[i].code_point = c;
+            stats->top_unsupported[i].count += count;
+            return;
+        }
+        if (stats->top_unsupported[i].count <
+            stats->top_unsupported[smallest].count)
+            smallest = i;
+    }
+
+    stats->top_unsupported[smallest].code_point = c;
+    stats->top_unsupported[smallest].count += count;
+}
+
+void stats_unsupported(utf8totex_stats_t *stats, uint32_t c) {
+    assert(stats != NULL);
+
+    stats->unsupported++;
+    add_unsupported(stats, c, 1);
+}
+
+void utf8totex_stats_merge(utf8totex_stats_t *into,
+        const utf8totex_stats_t *from) {
+    assert(into != NULL);
+    assert(from != NULL);
+
+    into->bytes_in += from->bytes_in;
+    into->bytes_out += from->bytes_out;
+    into->ascii += from->ascii;
+    into->sequence += from->sequence;
+    into->modifier += from->modifier;
+    into->unsupported += from->unsupported;
+    into->invalid += from->invalid;
+
+    for (size_t i = 0; i < UTF8TOTEX_STATS_TOP; i++) {
+        if (from->top_unsupported[i].count > 0)
+            add_unsupported(into, from->top_unsupported[i].code_point,
+                from->top_unsupported[i].count);
+    }
+}
@@ -0,0 +1,746 @@
+/* Translation stores.
+ *
+ * A store holds the translations of a set of keyed records for several
+ * environments, laid out so that it can be mapped into memory and looked up in
+ * place. The file is written in the byte order of the machine writing it and
+ * consists of:
+ *
+ *   * A header, followed by the environments the records were translated for.
+ *   * A blob of NUL-terminated strings. For each record, its key, its input
+ *     and its output for each environment.
+ *   * A table of records, giving where their key and input are in the blob.
+ *   * A table of outputs, one per record per environment, giving where each is
+ *     in the blob or how its translation failed.
+ *   * An open-addressed hash table with linear probing, mapping keys to
+ *     records.
+ *
+ * Keeping the input of each record lets an update reuse the output of records
+ * whose input has not changed, and retranslate every record when the library
+ * version or the options have.
+ *
+ * Stores are never modified in place. An update writes a new file alongside
+ * the old one and renames it over the top, so existing readers carry on with
+ * the old mapping undisturbed.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "utf8totex/utf8totex.h"
+
+#define MAGIC "u8txstr1"
+
+/* Marker for an unused hash table slot. */
+#define EMPTY UINT32_MAX
+
+typedef struct {
+    char magic[8];
+    char version[24]; /* `UTF8TOTEX_VERSION` that wrote the store */
+
+    /* Options the records were translated with */
+    uint32_t fuzzy;
+    uint32_t elide_braces;
+    uint32_t coalesce_math;
+    uint32_t envs;
+    uint64_t line_limit;
+
+    uint64_t records;
+    uint64_t slots;
+
+    /* Offsets of the tables */
+    uint64_t record_table;
+    uint64_t output_table;
+    uint64_t slot_table;
+
+    /* Total file size, to detect truncation */
+    uint64_t size;
+} header_t;
+
+typedef struct {
+    uint32_t font_encoding;
+    uint32_t textcomp;
+} env_t;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t key;   /* offset in the blob */
+    uint64_t input; /* offset in the blob */
+    uint32_t key_len;
+    uint32_t input_len;
+} record_t;
+
+typedef struct {
+    uint64_t offset; /* in the blob */
+    uint32_t len;
+    int32_t error;   /* `UTF8TOTEX_ASCII` on success */
+} output_t;
+
+struct utf8totex_store {
+    const char *base;
+    size_t size;
+    const header_t *header;
+    const env_t *envs;
+    const record_t *records;
+    const output_t *outputs;
+    const uint32_t *slots;
+};
+
+/* FNV-1a */
+static uint64_t hash(const char *s, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/* Whether a table of `n` entries of `size` bytes at `offset` fits within the
+ * file.
+ */
+static bool fits(uint64_t offset, uint64_t n, size_t size, uint64_t total) {
+    return offset <= total && n <= (total - offset) / size;
+}
+
+/* Map a store into memory, optionally rejecting one written by a different
+ * version of the library.
+ */
+static utf8totex_store_t *store_map(const char *path, bool check_version) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if ((uint64_t)st.st_size < sizeof(header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    utf8totex_store_t *s = malloc(sizeof(*s));
+    if (s == NULL) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    s->base = base;
+    s->size = (size_t)st.st_size;
+    s->header = base;
+
+    const header_t *h = s->header;
+    if (memcmp(h->magic, MAGIC, sizeof(h->magic)) != 0 ||
+        h->size != s->size ||
+        !fits(sizeof(*h), h->envs, sizeof(env_t), h->size) ||
+        !fits(h->record_table, h->records, sizeof(record_t), h->size) ||
+        h->records >= EMPTY ||
+        (h->envs != 0 &&
+         h->records > UINT64_MAX / h->envs) ||
+        !fits(h->output_table, h->records * h->envs, sizeof(output_t),
+              h->size) ||
+        h->slots == 0 || (h->slots & (h->slots - 1)) != 0 ||
+        h->slots <= h->records ||
+        !fits(h->slot_table, h->slots, sizeof(uint32_t), h->size) ||
+        h->record_table % 8 != 0 || h->output_table % 8 != 0 ||
+        h->slot_table % 4 != 0) {
+        utf8totex_store_free(s);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (check_version &&
+        strncmp(h->version, UTF8TOTEX_VERSION, sizeof(h->version)) != 0) {
+        utf8totex_store_free(s);
+        errno = ESTALE;
+        return NULL;
+    }
+
+    s->envs = (const env_t*)(s->base + sizeof(*h));
+    s->records = (const record_t*)(s->base + h->record_table);
+    s->outputs = (const output_t*)(s->base + h->output_table);
+    s->slots = (const uint32_t*)(s->base + h->slot_table);
+    return s;
+}
+
+utf8totex_store_t *utf8totex_store_open(const char *path) {
+    assert(path != NULL);
+    return store_map(path, true);
+}
+
+static size_t find_env(const utf8totex_store_t *s, utf8totex_environment_t env) {
+    for (size_t i = 0; i < s->header->envs; i++) {
+        if (s->envs[i].font_encoding == (uint32_t)env.font_encoding &&
+            !s->envs[i].textcomp == !env.textcomp)
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+/* Find the record with the given key, or return `EMPTY`. */
+static uint32_t find_record(const utf8totex_store_t *s, const char *key,
+        size_t len, uint64_t h) {
+    /* Bound the probing, in case the table is corrupt and has no free slot. */
+    const uint64_t mask = s->header->slots - 1;
+    uint64_t i = h & mask;
+    for (uint64_t n = 0; n < s->header->slots; n++, i = (i + 1) & mask) {
+        uint32_t r = s->slots[i];
+        if (r == EMPTY || r >= s->header->records)
+            return EMPTY;
+        const record_t *rec = &s->records[r];
+        if (rec->hash == h && rec->key_len == len &&
+            fits(rec->key, (uint64_t)len + 1, 1, s->size) &&
+            memcmp(s->base + rec->key, key, len) == 0)
+            return r;
+    }
+    return EMPTY;
+}
+
+const char *utf8totex_store_lookup(const utf8totex_store_t *s,
+        const char *key, utf8totex_environment_t env, size_t *len,
+        utf8totex_char_t *error) {
+    assert(s != NULL);
+    assert(key != NULL);
+
+    size_t e = find_env(s, env);
+    size_t key_len = strlen(key);
+    uint32_t r = e == SIZE_MAX ? EMPTY
+                               : find_record(s, key, key_len, hash(key, key_len));
+    if (r == EMPTY) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    const output_t *out = &s->outputs[(size_t)r * s->header->envs + e];
+    if (out->error != UTF8TOTEX_ASCII) {
+        if (error != NULL)
+            *error = (utf8totex_char_t)out->error;
+        errno = EILSEQ;
+        return NULL;
+    }
+    if (!fits(out->offset, (uint64_t)out->len + 1, 1, s->size)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (len != NULL)
+        *len = out->len;
+    return s->base + out->offset;
+}
+
+void utf8totex_store_free(utf8totex_store_t *s) {
+    if (s == NULL)
+        return;
+    munmap((void*)s->base, s->size);
+    free(s);
+}
+
+/* Updating. The new store is streamed out as records are translated, with
+ * only the tables kept in memory until the end.
+ */
+
+typedef enum {
+    LIVE,
+    DELETED,  /* still found, so that it is not carried over */
+    REPLACED, /* by a later record with the same key */
+} state_t;
+
+typedef struct {
+    FILE *f;
+    uint64_t pos; /* bytes written so far */
+
+    /* Records written, including those since deleted or replaced */
+    record_t *records;
+    output_t *outputs;
+    state_t *states;
+    size_t len;
+    size_t size;
+    size_t envs;
+
+    /* Keys of `records`, for finding duplicates before they are written out */
+    char *keys;
+    size_t keys_len;
+    size_t keys_size;
+    uint64_t *key_offsets;
+
+    /* Hash table over `records` */
+    uint32_t *slots;
+    size_t mask;
+
+    /* Per-environment translation buffers */
+    utf8totex_target_t *targets;
+    char **buffers;
+    size_t *buffer_sizes;
+} builder_t;
+
+static int put(builder_t *b, const void *p, size_t len) {
+    if (len > 0 && fwrite(p, 1, len, b->f) != len)
+        return -1;
+    b->pos += len;
+    return 0;
+}
+
+/* Write a NUL-terminated string to the blob, returning its offset. */
+static int put_str(builder_t *b, const char *s, size_t len, uint64_t *offset) {
+    *offset = b->pos;
+    if (put(b, s, len) != 0 || put(b, "", 1) != 0)
+        return -1;
+    return 0;
+}
+
+static int pad(builder_t *b, size_t align) {
+    static const char zero[8];
+    assert(align <= sizeof(zero));
+    return put(b, zero, (size_t)((align - b->pos % align) % align));
+}
+
+static uint32_t builder_find(const builder_t *b, const char *key, size_t len,
+        uint64_t h) {
+    if (b->slots == NULL)
+        return EMPTY;
+    for (size_t i = h & b->mask; ; i = (i + 1) & b->mask) {
+        uint32_t r = b->slots[i];
+        if (r == EMPTY)
+            return EMPTY;
+        if (b->records[r].hash == h && b->records[r].key_len == len &&
+            memcmp(b->keys + b->key_offsets[r], key, len) == 0)
+            return r;
+    }
+}
+
+static void builder_insert(builder_t *b, uint32_t r) {
+    size_t i = b->records[r].hash & b->mask;
+    while (b->slots[i] != EMPTY)
+        i = (i + 1) & b->mask;
+    b->slots[i] = r;
+}
+
+/* Make room for another record. */
+static int builder_grow(builder_t *b, size_t key_len) {
+    if (b->len + 1 >= EMPTY || key_len >= UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (b->len == b->size) {
+        size_t size = b->size == 0 ? 1024 : b->size * 2;
+        record_t *records = realloc(b->records, size * sizeof(records[0]));
+        if (records == NULL)
+            return -1;
+        b->records = records;
+        output_t *outputs = realloc(b->outputs,
+            size * b->envs * sizeof(outputs[0]));
+        if (outputs == NULL)
+            return -1;
+        b->outputs = outputs;
+        state_t *states = realloc(b->states, size * sizeof(states[0]));
+        if (states == NULL)
+            return -1;
+        b->states = states;
+        uint64_t *key_offsets = realloc(b->key_offsets,
+            size * sizeof(key_offsets[0]));
+        if (key_offsets == NULL)
+            return -1;
+        b->key_offsets = key_offsets;
+        b->size = size;
+    }
+
+    if (b->keys_len + key_len > b->keys_size) {
+        size_t size = b->keys_size == 0 ? 4096 : b->keys_size;
+        while (b->keys_len + key_len > size)
+            size *= 2;
+        char *keys = realloc(b->keys, size);
+        if (keys == NULL)
+            return -1;
+        b->keys = keys;
+        b->keys_size = size;
+    }
+
+    /* Keep the hash table at most half full. */
+    if ((b->len + 1) * 2 > b->mask + 1) {
+        size_t slots_len = b->mask == 0 ? 2048 : (b->mask + 1) * 2;
+        uint32_t *slots = malloc(slots_len * sizeof(slots[0]));
+        if (slots == NULL)
+            return -1;
+        memset(slots, 0xff, slots_len * sizeof(slots[0]));
+        free(b->slots);
+        b->slots = slots;
+        b->mask = slots_len - 1;
+        for (size_t r = 0; r < b->len; r++) {
+            if (b->states[r] != REPLACED)
+                builder_insert(b, (uint32_t)r);
+        }
+    }
+    return 0;
+}
+
+/* Start a record for `key`, replacing any earlier one. */
+static int builder_add(builder_t *b, const char *key, size_t key_len,
+        uint64_t h, uint32_t *r) {
+    uint32_t old = builder_find(b, key, key_len, h);
+    if (old != EMPTY)
+        b->states[old] = REPLACED;
+    if (builder_grow(b, key_len) != 0)
+        return -1;
+
+    *r = (uint32_t)b->len++;
+    b->records[*r].hash = h;
+    b->records[*r].key_len = (uint32_t)key_len;
+    b->states[*r] = LIVE;
+    b->key_offsets[*r] = b->keys_len;
+    memcpy(b->keys + b->keys_len, key, key_len);
+    b->keys_len += key_len;
+
+    /* Take over the slot of the record replaced, unless growing rebuilt the
+     * table without it.
+     */
+    for (size_t i = h & b->mask; ; i = (i + 1) & b->mask) {
+        if (b->slots[i] == EMPTY || b->slots[i] == old) {
+            b->slots[i] = *r;
+            return 0;
+        }
+    }
+}
+
+/* Whether outputs in `old` can be reused with these options. */
+static bool compatible(const utf8totex_store_t *old,
+        utf8totex_options_t options) {
+    const header_t *h = old->header;
+    return strncmp(h->version, UTF8TOTEX_VERSION, sizeof(h->version)) == 0 &&
+           h->fuzzy == (uint32_t)options.fuzzy &&
+           h->elide_braces == (uint32_t)options.elide_braces &&
+           h->coalesce_math == (uint32_t)options.coalesce_math &&
+           h->line_limit == (uint64_t)options.line_limit;
+}
+
+/* Write a record's key, input and outputs. If `old` has up to date outputs
+ * for the same input, these are copied rather than translating it again.
+ */
+static int builder_record(builder_t *b, const char *key, size_t key_len,
+        const char *input, size_t input_len, utf8totex_options_t options,
+        const utf8totex_environment_t *envs, const utf8totex_store_t *old,
+        const size_t *old_envs) {
+    if (input_len >= UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    uint64_t h = hash(key, key_len);
+    uint32_t r;
+    if (builder_add(b, key, key_len, h, &r) != 0)
+        return -1;
+    record_t *rec = &b->records[r];
+    rec->input_len = (uint32_t)input_len;
+    if (put_str(b, key, key_len, &rec->key) != 0 ||
+        put_str(b, input, input_len, &rec->input) != 0)
+        return -1;
+    output_t *outputs = &b->outputs[(size_t)r * b->envs];
+
+    uint32_t o = old == NULL ? EMPTY : find_record(old, key, key_len, h);
+    if (o != EMPTY && old->records[o].input_len == input_len &&
+        fits(old->records[o].input, (uint64_t)input_len, 1, old->size) &&
+        memcmp(old->base + old->records[o].input, input, input_len) == 0) {
+        const output_t *old_outputs = &old->outputs[(size_t)o * old->header->envs];
+        for (size_t i = 0; i < b->envs; i++) {
+            const output_t *src = &old_outputs[old_envs[i]];
+            outputs[i] = *src;
+            if (src->error != UTF8TOTEX_ASCII)
+                continue;
+            if (!fits(src->offset, (uint64_t)src->len + 1, 1, old->size)) {
+                errno = EINVAL;
+                return -1;
+            }
+            if (put_str(b, old->base + src->offset, src->len,
+                        &outputs[i].offset) != 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    /* The input is NUL-terminated in the blob but we may not be able to read
+     * it back, so translate a copy.
+     */
+    char *s = strndup(input, input_len);
+    if (s == NULL)
+        return -1;
+    for (size_t i = 0; i < b->envs; i++) {
+        rewind(b->targets[i].f);
+        b->targets[i].env = envs[i];
+    }
+    (void)utf8totex_fputs_multi(s, options, b->targets, b->envs);
+    free(s);
+
+    for (size_t i = 0; i < b->envs; i++) {
+        const utf8totex_target_t *t = &b->targets[i];
+        if (t->result != 0) {
+            if (t->error == UTF8TOTEX_EOF)
+                return -1;
+            outputs[i] = (output_t){ .error = t->error };
+            continue;
+        }
+        off_t len = ftello(t->f);
+        if (len < 0 || fflush(t->f) != 0)
+            return -1;
+        if ((uint64_t)len >= UINT32_MAX) {
+            errno = EOVERFLOW;
+            return -1;
+        }
+        outputs[i].len = (uint32_t)len;
+        outputs[i].error = UTF8TOTEX_ASCII;
+        if (put_str(b, b->buffers[i], (size_t)len, &outputs[i].offset) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Write out the tables and header. */
+static int builder_finish(builder_t *b, utf8totex_options_t options) {
+    header_t h = {
+        .fuzzy = options.fuzzy,
+        .elide_braces = (uint32_t)options.elide_braces,
+        .coalesce_math = options.coalesce_math,
+        .envs = (uint32_t)b->envs,
+        .line_limit = options.line_limit,
+    };
+    memcpy(h.magic, MAGIC, sizeof(h.magic));
+    strncpy(h.version, UTF8TOTEX_VERSION, sizeof(h.version));
+
+    /* Compact the tables down to the records still live. */
+    size_t n = 0;
+    for (size_t r = 0; r < b->len; r++) {
+        if (b->states[r] != LIVE)
+            continue;
+        b->records[n] = b->records[r];
+        memmove(&b->outputs[n * b->envs], &b->outputs[r * b->envs],
+            b->envs * sizeof(b->outputs[0]));
+        n++;
+    }
+    h.records = n;
+
+    if (pad(b, 8) != 0)
+        return -1;
+    h.record_table = b->pos;
+    if (put(b, b->records, n * sizeof(b->records[0])) != 0)
+        return -1;
+    h.output_table = b->pos;
+    if (put(b, b->outputs, n * b->envs * sizeof(b->outputs[0])) != 0)
+        return -1;
+
+    h.slots = 1;
+    while (h.slots < 2 * n + 1)
+        h.slots *= 2;
+    free(b->slots);
+    b->slots = malloc(h.slots * sizeof(b->slots[0]));
+    if (b->slots == NULL)
+        return -1;
+    memset(b->slots, 0xff, h.slots * sizeof(b->slots[0]));
+    b->mask = h.slots - 1;
+    for (size_t r = 0; r < n; r++)
+        builder_insert(b, (uint32_t)r);
+    h.slot_table = b->pos;
+    if (put(b, b->slots, h.slots * sizeof(b->slots[0])) != 0)
+        return -1;
+    h.size = b->pos;
+
+    if (fseeko(b->f, 0, SEEK_SET) != 0 ||
+        fwrite(&h, sizeof(h), 1, b->f) != 1 ||
+        fflush(b->f) != 0 || fsync(fileno(b->f)) != 0)
+        return -1;
+    return 0;
+}
+
+static void builder_free(builder_t *b) {
+    for (size_t i = 0; i < b->envs; i++) {
+        if (b->targets[i].f != NULL)
+            fclose(b->targets[i].f);
+        free(b->buffers[i]);
+    }
+    free(b->buffer_sizes);
+    free(b->buffers);
+    free(b->targets);
+    free(b->slots);
+    free(b->key_offsets);
+    free(b->keys);
+    free(b->states);
+    free(b->outputs);
+    free(b->records);
+}
+
+int utf8totex_store_update(const char *path, FILE *records,
+        utf8totex_options_t options, const utf8totex_environment_t *envs,
+        size_t n) {
+    assert(path != NULL);
+    assert(records != NULL);
+    assert(envs != NULL || n == 0);
+
+    /* None of these can be recorded in the store. */
+    options.map = NULL;
+    options.stats = NULL;
+    options.srcmap = NULL;
+    options.translit = NULL;
+    options.verbatim = NULL;
+
+    if (n == 0 || n > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    utf8totex_store_t *old = store_map(path, false);
+    if (old == NULL && errno != ENOENT)
+        return -1;
+
+    builder_t b = { .envs = n };
+    char *tmp_path = NULL;
+    bool created = false;
+    int fd = -1;
+    char *line = NULL;
+    size_t *old_envs = NULL;
+    int saved_errno;
+
+    /* Outputs of the old store can be reused if they were produced in the same
+     * way for every environment we want.
+     */
+    const utf8totex_store_t *reuse = NULL;
+    if (old != NULL && compatible(old, options)) {
+        old_envs = malloc(n * sizeof(old_envs[0]));
+        if (old_envs == NULL)
+            goto fail;
+        reuse = old;
+        for (size_t i = 0; i < n; i++) {
+            old_envs[i] = find_env(old, envs[i]);
+            if (old_envs[i] == SIZE_MAX)
+                reuse = NULL;
+        }
+    }
+
+    b.targets = calloc(n, sizeof(b.targets[0]));
+    b.buffers = calloc(n, sizeof(b.buffers[0]));
+    b.buffer_sizes = calloc(n, sizeof(b.buffer_sizes[0]));
+    if (b.targets == NULL || b.buffers == NULL || b.buffer_sizes == NULL)
+        goto fail;
+    for (size_t i = 0; i < n; i++) {
+        b.targets[i].f = open_memstream(&b.buffers[i], &b.buffer_sizes[i]);
+        if (b.targets[i].f == NULL)
+            goto fail;
+    }
+
+    size_t tmp_size = strlen(path) + sizeof(".XXXXXX");
+    tmp_path = malloc(tmp_size);
+    if (tmp_path == NULL)
+        goto fail;
+    snprintf(tmp_path, tmp_size, "%s.XXXXXX", path);
+    fd = mkstemp(tmp_path);
+    if (fd < 0)
+        goto fail;
+    created = true;
+    b.f = fdopen(fd, "w");
+    if (b.f == NULL)
+        goto fail;
+    fd = -1;
+
+    /* Leave room for the header, written last. */
+    header_t placeholder = { 0 };
+    if (put(&b, &placeholder, sizeof(placeholder)) != 0)
+        goto fail;
+    for (size_t i = 0; i < n; i++) {
+        env_t e = { (uint32_t)envs[i].font_encoding, envs[i].textcomp };
+        if (put(&b, &e, sizeof(e)) != 0)
+            goto fail;
+    }
+
+    /* New and changed records. */
+    size_t line_size = 0;
+    ssize_t len;
+    errno = 0;
+    while ((len = getline(&line, &line_size, records)) != -1) {
+        if (len > 0 && line[len - 1] == '\n')
+            line[--len] = '\0';
+        if (len == 0)
+            continue;
+        char *tab = memchr(line, '\t', (size_t)len);
+        if (tab == NULL) {
+            /* A key on its own deletes it. */
+            uint64_t h = hash(line, (size_t)len);
+            uint32_t r = builder_find(&b, line, (size_t)len, h);
+            if (r == EMPTY &&
+                builder_add(&b, line, (size_t)len, h, &r) != 0)
+                goto fail;
+            b.states[r] = DELETED;
+            continue;
+        }
+        size_t key_len = (size_t)(tab - line);
+        if (builder_record(&b, line, key_len, tab + 1,
+                (size_t)len - key_len - 1, options, envs, reuse,
+                old_envs) != 0)
+            goto fail;
+        errno = 0;
+    }
+    if (errno != 0 || ferror(records))
+        goto fail;
+
+    /* Records carried over from the old store. */
+    for (size_t r = 0; old != NULL && r < old->header->records; r++) {
+        const record_t *rec = &old->records[r];
+        if (!fits(rec->key, (uint64_t)rec->key_len + 1, 1, old->size) ||
+            !fits(rec->input, (uint64_t)rec->input_len + 1, 1, old->size)) {
+            errno = EINVAL;
+            goto fail;
+        }
+        const char *key = old->base + rec->key;
+        if (builder_find(&b, key, rec->key_len, rec->hash) != EMPTY)
+            continue;
+        if (builder_record(&b, key, rec->key_len, old->base + rec->input,
+                rec->input_len, options, envs, reuse, old_envs) != 0)
+            goto fail;
+    }
+
+    if (builder_finish(&b, options) != 0)
+        goto fail;
+    FILE *f = b.f;
+    b.f = NULL;
+    if (fclose(f) != 0)
+        goto fail;
+    /* Mode from `mkstemp` is 0600; make stores shareable. */
+    (void)chmod(tmp_path, 0644);
+    if (rename(tmp_path, path) != 0)
+        goto fail;
+
+    free(line);
+    free(tmp_path);
+    free(old_envs);
+    builder_free(&b);
+    utf8totex_store_free(old);
+    return 0;
+
+fail:
+    saved_errno = errno;
+    if (b.f != NULL)
+        fclose(b.f);
+    if (fd >= 0)
+        close(fd);
+    if (created)
+        unlink(tmp_path);
+    free(line);
+    free(tmp_path);
+    free(old_envs);
+    builder_free(&b);
+    utf8totex_store_free(old);
+    errno = saved_errno;
+    return -1;
+}
@@ -0,0 +1,5 @@
+#include "utf8totex/utf8totex.h"
+
+const char *utf8totex_version(void) {
+    return UTF8TOTEX_VERSION;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Checks of the command line tool.
+#
+# Usage: cli.sh path/to/utf8totex
+
+bin=$1
+failed=0
+
+# check NAME INPUT EXPECTED [ARGUMENT...]: feed INPUT, a printf format, to the
+# tool with the given arguments and compare its output to EXPECTED, another.
+check() {
+    name=$1 input=$2 expected=$3
+    shift 3
+    actual=$(printf "$input" | "$bin" "$@"; echo .)
+    want=$(printf "$expected"; echo .)
+    if [ "$actual" != "$want" ]; then
+        printf 'FAIL %s\n  expected: %s\n  actual:   %s\n' "$name" "$want" \
+            "$actual"
+        failed=1
+    fi
+}
+
+check plain 'café\n' "caf{\\\\'e}\n"
+
+# Fuzzy mode state carries across lines, with or without threads.
+check verbatim-lines '\\begin{verbatim}\ncafé $x\n\\end{verbatim}\n' \
+    '\\begin{verbatim}\ncafé $x\n\\end{verbatim}\n' --fuzzy
+check display-math-lines '$$\nα\n$$\n' '$$\n\\alpha\n$$\n' --fuzzy
+check display-math-lines-threads '$$\nα\n$$\n' '$$\n\\alpha\n$$\n' --fuzzy \
+    --threads 2
+
+exit $failed
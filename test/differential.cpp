@@ -0,0 +1,132 @@
+/* Differential check of the C++ interface against the C one.
+ *
+ * utf8totex.hpp duplicates the translation loop of fputs.c and the fuzzy mode
+ * state machine of fuzzy.c, so the two can silently drift apart. This
+ * translates random inputs, built from pieces chosen to reach the interesting
+ * paths, under random options with both `utf8totex_fputs_opt` and
+ * `utf8totex::translate` (through each kind of sink) and fails on any
+ * difference in output, result or reported character.
+ *
+ * Usage: utf8totex-differential [iterations [seed]]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+#include "utf8totex/utf8totex.h"
+#include "utf8totex/utf8totex.hpp"
+
+static const char *const pieces[] = {
+    "a", "b", "e", "i", "j", "o", "x", "Q", "0", "9", ".", "*", "|", "[", "]",
+    " ", "  ", "\n", "\t", "{", "}", "\\", "$", "$$", "%", "#", "~", "^", "_",
+    "&", "\\$", "\\(", "\\)", "\\[", "\\]", "\\alpha", "\\emph", "\\begin",
+    "\\url", "\\verb", "\\begin{verbatim}", "\\end{verbatim}",
+    "é", "ß", "Æ", "ı", "ﬁ", "Ĳ", "€", "©", "—", "“", "”", "→", "≤", "∈", "中",
+    "α", "β", "ο", "П", "р", "и", "ї", "Ё", "Ґ", "я", "Щ",
+    "\xcc\x81", "\xcc\x88", "\xcc\xa7", /* combining acute, diaeresis, cedilla */
+    "\xff",                             /* invalid */
+};
+
+/* An overlay that shadows a few table entries, including one for math mode. */
+static const char map_text[] = "é {\\myeacute}\nα $\\alpha$\nx {\\ex}\n";
+
+static utf8totex_map_t *load_map(void) {
+    char path[] = "/tmp/utf8totex-differential-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return nullptr;
+    bool ok = write(fd, map_text, sizeof(map_text) - 1) ==
+              (ssize_t)(sizeof(map_text) - 1);
+    close(fd);
+    utf8totex_map_t *map = ok ? utf8totex_map_load(path, nullptr) : nullptr;
+    unlink(path);
+    return map;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 20000;
+    std::mt19937 rng(argc > 2 ? strtoul(argv[2], nullptr, 10) : 1);
+
+    utf8totex_map_t *map = load_map();
+    if (map == nullptr) {
+        fprintf(stderr, "failed to load map\n");
+        return EXIT_FAILURE;
+    }
+
+    long bad = 0;
+    for (long iter = 0; iter < iterations; iter++) {
+        std::string in;
+        for (unsigned n = rng() % 40; n > 0; n--)
+            in += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+
+        utf8totex_options_t o{};
+        o.fuzzy = rng() % 2;
+        o.elide_braces = (utf8totex_elide_t)(rng() % 3);
+        o.coalesce_math = rng() % 2;
+        o.line_limit = rng() % 3 == 0 ? 0 : rng() % 20 + 1;
+        o.env.font_encoding = (decltype(o.env.font_encoding))(rng() % 18);
+        o.env.textcomp = rng() % 2;
+        if (rng() % 4 == 0)
+            o.map = map;
+
+        utf8totex_char_t e1 = UTF8TOTEX_ASCII, e2 = UTF8TOTEX_ASCII;
+        char *buf;
+        size_t size;
+        FILE *f = open_memstream(&buf, &size);
+        if (f == nullptr) {
+            fprintf(stderr, "open_memstream failed\n");
+            return EXIT_FAILURE;
+        }
+        int r1 = utf8totex_fputs_opt(in.c_str(), o, f, &e1);
+        fclose(f);
+        std::string expected(buf, size);
+        free(buf);
+
+        std::string out;
+        int r2;
+        switch (iter % 4) {
+        case 0:
+            r2 = utf8totex::translate(in, out, o, &e2);
+            break;
+        case 1: {
+            std::vector<char> v;
+            r2 = utf8totex::translate(std::vector<char>(in.begin(), in.end()),
+                                      std::back_inserter(v), o, &e2);
+            out.assign(v.begin(), v.end());
+            break;
+        }
+        case 2: {
+            std::pmr::string p;
+            r2 = utf8totex::translate(std::string_view(in), p, o, &e2);
+            out = p;
+            break;
+        }
+        default: {
+            char raw[4096];
+            char *p = raw;
+            r2 = utf8totex::translate(in, p, o, &e2);
+            out.assign(raw, p);
+            break;
+        }
+        }
+
+        if (r1 != r2 || expected != out || (r1 != 0 && e1 != e2)) {
+            if (bad++ < 5)
+                fprintf(stderr,
+                        "mismatch on [%s]\n  result %d/%d, char %d/%d\n"
+                        "  C:   [%s]\n  C++: [%s]\n",
+                        in.c_str(), r1, r2, (int)e1, (int)e2, expected.c_str(),
+                        out.c_str());
+        }
+    }
+
+    utf8totex_map_free(map);
+    printf("%ld of %ld inputs differ\n", bad, iterations);
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}